@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -20,15 +20,19 @@
 #include <sys/wait.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/socket.h>
 #include <sys/un.h>
-#include <netdb.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <sys/utsname.h>
 #include <sys/eventfd.h>
-#include <linux/aio_abi.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <linux/fs.h>
 #include "lxtst.h"
+#include "lxaio.h"
 
 #define _GNU_SOURCE
 #include <sys/syscall.h>
@@ -38,6 +42,11 @@
 #define	FILE_BLOCKS	(NPAR)
 #define	BIG_FILE	512
 #define BLOCK_TAG	"test data in block %d"
+#define	RING_THREADS	4
+#define	VEC_MAX		1024	/* UIO_MAXIOV */
+
+/* iocbs in the pool; test1 holds BIG_FILE at once */
+#define	POOL_SLOTS	(2 * BIG_FILE)
 
 #define	TST_KILL	0x01
 #define	TST_CORE	0x02
@@ -51,17 +60,22 @@ static char tst_file[80];
 
 static int is_lx = 0;
 static aio_context_t gctx;
-static int gztot;
-static int state;
+static volatile int gztot;
+static volatile int state;
+static volatile int thr_id;
 static int evfd;
+static aio_pool_t *gpool;
+static uint32_t blk_crc[BIG_FILE];	/* of each block test1 writes */
 static struct timespec delay;
+static volatile int sig_count;
+static int pget_rc;
 
 static void
 tfail(char *msg)
 {
-        printf("FAIL aio %d: %s\n", tc, msg);
+	(void) test_case_fail("aio", tc, msg);
 	unlink(tst_file);
-        exit(1);
+	exit(1);
 }
 
 static void
@@ -73,137 +87,51 @@ t_err(char *msg, int rc, int en)
 	tfail(e);
 }
 
-int
-io_setup(int nr, aio_context_t *ctxp)
-{
-	return (syscall(SYS_io_setup, nr, ctxp));
-}
-
-int
-io_submit(aio_context_t ctx, long nr, struct iocb *cbpp[])
-{
-	return (syscall(SYS_io_submit, ctx, nr, cbpp));
-}
-
-int
-io_getevents(aio_context_t ctx, long minnr, long nr, struct io_event *ep,
-    struct timespec *tp)
-{
-	return (syscall(SYS_io_getevents, ctx, minnr, nr, ep, tp));
-}
-
-int
-io_cancel(aio_context_t ctx, struct iocb *cb, struct io_event *ep)
+/* Called by a test's second thread once it's running */
+static void
+thr_started()
 {
-	return (syscall(SYS_io_cancel, ctx, cb, ep));
+	thr_id = syscall(SYS_gettid);
+	rdv_set(&state, 1);
 }
 
-int
-io_destroy(aio_context_t ctx)
+/* Wait for the test's second thread to start and then block, e.g. for events */
+static void
+wait_thr_blocked()
 {
-	return (syscall(SYS_io_destroy, ctx));
+	if (rdv_wait_ne(&state, 0) != 0)
+		t_err("thread start", -1, errno);
+	if (rdv_blocked(thr_id) != 0)
+		t_err("thread block", -1, errno);
 }
 
+/* Take an iocb, with a BLKSIZE buffer, from the pool */
 static struct iocb *
 mk_cb(int fd, int op, size_t offset, long data)
 {
 	struct iocb *io;
-	char *buf;
 
-	buf = (char *)malloc(BLKSIZE);
-	io = (struct iocb *)calloc(1, sizeof (struct iocb));
-	if (buf == NULL || io == NULL)
-		tfail("out of memory");
+	if ((io = aio_pool_get(gpool)) == NULL)
+		tfail("iocb pool is empty");
 
 	io->aio_data = data;
 	io->aio_key = 0;
 	io->aio_lio_opcode = op;
 	io->aio_reqprio = 0;
 	io->aio_fildes = fd;
-	io->aio_buf = (__u64)buf;
 	io->aio_nbytes = BLKSIZE;
 	io->aio_offset = offset;
 	io->aio_flags = 0;
+	io->aio_rw_flags = 0;
 
 	return (io);
 }
 
-static int
-setup_sock()
-{
-	struct sockaddr_in addr;
-	int fd;
-	struct hostent *server;
-
-	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
-		perror("socket error");
-		exit(-1);
-	}
-
-	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-		perror("socket error");
-		exit(-1);
-	}
-	
-	server = gethostbyname("localhost");
-	if (server == NULL) {
-		fprintf(stderr,"ERROR, no such host\n");
-		exit(0);
-	}
-   
-	bzero((char *) &addr, sizeof(addr));
-	addr.sin_family = AF_INET;
-	bcopy((char *)server->h_addr, (char *)&addr.sin_addr.s_addr,
-	    server->h_length);
-	addr.sin_port = htons(5001);
-   
-	/* Now connect to the server */
-	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-		perror("connect error");
-		exit(-1);
-	}
-
-	return (fd);
-}
-
+/* Give an iocb from mk_cb() back to the pool, along with its buffer */
 static void
-tsrv()
+rel_cb(struct iocb *io)
 {
-	struct sockaddr_in addr;
-	int fd, cl;
-
-	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-		perror("socket error");
-		exit(-1);
-	}
-   
-	bzero((char *) &addr, sizeof(addr));
-   
-	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = INADDR_ANY;
-	addr.sin_port = htons(5001);
-   
-	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-		perror("bind error");
-		exit(-1);
-	}
-
-	state = 1;
-	if (listen(fd, 5) == -1) {
-		perror("listen error");
-		exit(-1);
-	}
-
-	if ((cl = accept(fd, NULL, NULL)) == -1) {
-		perror("accept error");
-		exit(1);
-	}
-
-	while (state < 2)
-                nanosleep(&delay, NULL);
-
-	close(cl);
-	close(fd);
+	aio_pool_put(gpool, io);
 }
 
 /* Run a test case in a different process */
@@ -213,8 +141,12 @@ run_as_proc(int tstcase, int (*tf)(), void *arg)
 	int pid;
 	int status;
 	int res;
+	char e[80];
+
+	if (!test_selected(tstcase))
+		return (0);
 
-	tc = tstcase;
+	tc = test_case("aio", tstcase);
 	pid = fork();
 	if (pid < 0)
 		t_err("fork", pid, errno);
@@ -228,8 +160,32 @@ run_as_proc(int tstcase, int (*tf)(), void *arg)
 	waitpid(pid, &status, 0);
 	if (WEXITSTATUS(status) == 0)
 		return (0);
-	printf("FAIL aio %d, status: %d\n", tc, WEXITSTATUS(status));
-	exit(1);
+	snprintf(e, sizeof (e), "exit status %d", WEXITSTATUS(status));
+	tfail(e);
+	return (1);
+}
+
+/* Check that every block which test1 wrote ended up in the right place */
+static void
+check_blocks(char *fname)
+{
+	int fd, i;
+	char *p;
+
+	if ((fd = open(fname, O_RDONLY)) < 0)
+		t_err("open", fd, errno);
+
+	p = mmap(NULL, BIG_FILE * BLKSIZE, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		t_err("mmap", -1, errno);
+
+	for (i = 0; i < BIG_FILE; i++) {
+		if (crc32c(0, p + i * BLKSIZE, BLKSIZE) != blk_crc[i])
+			tfail("block checksum mismatch");
+	}
+
+	(void) munmap(p, BIG_FILE * BLKSIZE);
+	close(fd);
 }
 
 /*
@@ -244,7 +200,7 @@ test1(char *fname)
 	aio_context_t ctx;
 	struct iocb **ioq;
 
-	tc = 1;
+	tc = test_case("aio", 1);
 	if ((rand_fd = open("/dev/urandom", O_RDONLY)) < 0) {
 		perror("open /dev/urandom");
 		exit(1);
@@ -266,24 +222,13 @@ test1(char *fname)
 		char *buf;
 		struct iocb *io;
 
-		buf = (char *)malloc(BLKSIZE);
-		io = (struct iocb *)calloc(1, sizeof (struct iocb));
-		if (buf == NULL || io == NULL)
-			tfail("out of memory");
+		io = mk_cb(fd, IOCB_CMD_PWRITE, i * BLKSIZE, (long)i);
+		buf = (char *)io->aio_buf;
 
 		if ((rc = read(rand_fd, buf, BLKSIZE)) != BLKSIZE)
 			t_err("read", rc, errno);
 		snprintf(buf, BLKSIZE, BLOCK_TAG, i);
-
-		io->aio_data = i;
-		io->aio_key = 0;
-		io->aio_lio_opcode = IOCB_CMD_PWRITE;
-		io->aio_reqprio = 0;
-		io->aio_fildes = fd;
-		io->aio_buf = (__u64)buf;
-		io->aio_nbytes = BLKSIZE;
-		io->aio_offset = i * BLKSIZE;
-		io->aio_flags = 0;
+		blk_crc[i] = crc32c(0, buf, BLKSIZE);
 
 		ioq[i] = io;
 	}
@@ -321,8 +266,7 @@ test1(char *fname)
 		if (iop->aio_offset != (n * BLKSIZE))
 			tfail("unexpected offset");
 
-		free((void *)iop->aio_buf);
-		free(iop);
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx);
@@ -330,6 +274,7 @@ test1(char *fname)
 		t_err("destroy", rc, errno);
 
 	close(fd);
+	check_blocks(fname);
 	return (0);
 }
 
@@ -346,7 +291,7 @@ test2(char *fname, int tnum)
 	aio_context_t ctx;
 	struct iocb **ioq;
 
-	tc = tnum;
+	tc = test_case("aio", tnum);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -430,8 +375,10 @@ retry:
 		if (strncmp(ebuf, tag, len) != 0)
 			tfail("unexpected block tag");
 
-		free((void *)iop->aio_buf);
-		free(iop);
+		if (crc32c(0, ebuf, BLKSIZE) != blk_crc[n])
+			tfail("unexpected block data");
+
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx);
@@ -451,7 +398,7 @@ test5(char *fname)
 	struct iocb **ioq;
 	struct io_event events[NPAR];
 
-	tc = 5;
+	tc = test_case("aio", 5);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -506,8 +453,10 @@ test5(char *fname)
 		if (strncmp(ebuf, tag, len) != 0)
 			tfail("unexpected block tag");
 
-		free((void *)iop->aio_buf);
-		free(iop);
+		if (crc32c(0, ebuf, BLKSIZE) != blk_crc[n])
+			tfail("unexpected block data");
+
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx);
@@ -531,7 +480,7 @@ test6(char *fname)
 	struct iocb **ioq;
 	struct io_event dummy;
 
-	tc = 6;
+	tc = test_case("aio", 6);
 	/* initialize */
 	ctx = 0;
 	rc = io_setup(n, &ctx);
@@ -590,14 +539,15 @@ test6(char *fname)
 				t_err("cancel result", n, ep->res);
 		}
 
-		free((void *)iop->aio_buf);
-		free(iop);
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx);
 	if (rc != 0)
 		t_err("destroy", rc, errno);
 
+	free(ioq);
+	close(fd);
 	return (0);
 }
 
@@ -611,7 +561,7 @@ test7(char *fname)
 	aio_context_t ctx;
 	struct iocb **ioq;
 
-	tc = 7;
+	tc = test_case("aio", 7);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -641,7 +591,8 @@ test7(char *fname)
 }
 
 /*
- * Test fsync.
+ * Test fsync. Linux kernels before 4.18 have no aio fsync and refuse it with
+ * EINVAL, in which case there's nothing to test.
  */
 static int
 test8(char *fname)
@@ -654,7 +605,7 @@ test8(char *fname)
 	struct iocb *iop;
 	int n;
 
-	tc = 8;
+	tc = test_case("aio", 8);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -667,20 +618,20 @@ test8(char *fname)
 	if (ioq == NULL)
 		tfail("out of memory");
 
-	io = (struct iocb *)calloc(1, sizeof (struct iocb));
-	if (io == NULL)
-		tfail("out of memory");
-
-	io->aio_data = 16;
-	io->aio_key = 0;
-	io->aio_lio_opcode = IOCB_CMD_FSYNC;
-	io->aio_reqprio = 0;
-	io->aio_fildes = fd;
-	io->aio_flags = 0;
+	io = mk_cb(fd, IOCB_CMD_FSYNC, 0, 16L);
+	io->aio_buf = 0;	/* fsync must have no buffer */
+	io->aio_nbytes = 0;
 
 	ioq[0] = io;
 
 	rc = io_submit(ctx, 1, ioq);
+	if (rc < 0 && errno == EINVAL && !is_lx) {
+		rel_cb(io);
+		free(ioq);
+		(void) io_destroy(ctx);
+		close(fd);
+		return (0);
+	}
 	if (rc != 1)
 		t_err("submit", rc, errno);
 
@@ -698,8 +649,7 @@ test8(char *fname)
 	if (ep->res != 0)
 		tfail("unexpected res");
 
-	free((void *)iop->aio_buf);
-	free(iop);
+	rel_cb(iop);
 
 	rc = io_destroy(ctx);
 	if (rc != 0)
@@ -721,7 +671,7 @@ test9(char *fname)
 	int n;
 	struct iocb *io;
 
-	tc = 9;
+	tc = test_case("aio", 9);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -735,7 +685,6 @@ test9(char *fname)
 		tfail("out of memory");
 
 	io = mk_cb(fd, IOCB_CMD_PREAD, 0, (long)47);
-	free((void *)io->aio_buf);
 	io->aio_buf = (__u64)NULL;
 	io->aio_nbytes = 0;
 	io->aio_offset = 47;
@@ -765,9 +714,7 @@ test9(char *fname)
 	if (iop->aio_offset != 47)
 		tfail("unexpected offset");
 
-	free((void *)iop->aio_buf);
-	free(iop);
-
+	rel_cb(iop);
 
 	rc = io_destroy(ctx);
 	if (rc != 0)
@@ -786,7 +733,7 @@ test10(char *fname)
 	struct iocb **ioq;
 	struct io_event events[NPAR];
 
-	tc = 10;
+	tc = test_case("aio", 10);
 	if ((fd0 = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd0, errno);
 
@@ -857,8 +804,7 @@ test10(char *fname)
 		if (strncmp(ebuf, tag, len) != 0)
 			tfail("unexpected block tag");
 
-		free((void *)iop->aio_buf);
-		free(iop);
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx);
@@ -882,7 +828,7 @@ test11(char *fname)
 	struct iocb **ioq;
 	struct iocb *io;
 
-	tc = 11;
+	tc = test_case("aio", 11);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -917,6 +863,8 @@ test11(char *fname)
 		t_err("submit", rc, err);
 	}
 
+	rel_cb(io);
+
 	rc = io_destroy(ctx);
 	if (rc != 0)
 		t_err("destroy", rc, errno);
@@ -938,7 +886,7 @@ test12(char *fname)
 	struct io_event events[NPAR];
 	struct iocb *io;
 
-	tc = 12;
+	tc = test_case("aio", 12);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -971,9 +919,8 @@ test12(char *fname)
 	iop = (struct iocb *)ep->obj;
 	if (ep->res != BLKSIZE)
 		tfail("unexpected res");
-	free((void *)iop->aio_buf);
-
-	free(iop);
+	rel_cb(iop);
+	rel_cb(ioq[1]);
 
 	rc = io_destroy(ctx);
 	if (rc != 0)
@@ -996,7 +943,7 @@ test13(char *fname)
 	struct io_event events[NPAR];
 	struct iocb *io;
 
-	tc = 13;
+	tc = test_case("aio", 13);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1012,7 +959,6 @@ test13(char *fname)
 	io = mk_cb(fd, IOCB_CMD_PREAD, 0, 0L);
 	ioq[0] = io;
 	io = mk_cb(fd, IOCB_CMD_PREAD, BLKSIZE, 0L);
-	free((void *)io->aio_buf);
 	io->aio_buf = (__u64)2048;
 	ioq[1] = io;
 
@@ -1035,10 +981,9 @@ test13(char *fname)
 		} else {
 			if (ep->res != BLKSIZE)
 				tfail("unexpected res");
-			free((void *)iop->aio_buf);
 		}
 
-		free(iop);
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx);
@@ -1056,7 +1001,7 @@ test14(char *fname)
 	int rc;
 	aio_context_t ctx;
 
-	tc = 14;
+	tc = test_case("aio", 14);
 	ctx = 0;
 	rc = io_setup(NPAR, &ctx);
 	if (rc < 0)
@@ -1076,7 +1021,7 @@ test15(char *fname)
 	int i, rc;
 	aio_context_t ctx[5];
 
-	tc = 15;
+	tc = test_case("aio", 15);
 	for (i = 0; i < 5; i++) {
 		ctx[i] = 0;
 		rc = io_setup((16 * 1024), &ctx[i]);
@@ -1105,7 +1050,7 @@ test16(char *fname)
 	aio_context_t ctx0, ctx1;
 	struct iocb **ioq0, **ioq1;
 
-	tc = 16;
+	tc = test_case("aio", 16);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1173,8 +1118,10 @@ test16(char *fname)
 		if (strncmp(ebuf, tag, len) != 0)
 			tfail("unexpected block tag");
 
-		free((void *)iop->aio_buf);
-		free(iop);
+		if (crc32c(0, ebuf, BLKSIZE) != blk_crc[n])
+			tfail("unexpected block data");
+
+		rel_cb(iop);
 	}
 
 	rc = io_destroy(ctx0);
@@ -1224,14 +1171,16 @@ test17_val()
 	if (strncmp(ebuf, tag, len) != 0)
 		tfail("unexpected block tag");
 
-	free((void *)iop->aio_buf);
-	free(iop);
+	if (crc32c(0, ebuf, BLKSIZE) != blk_crc[n])
+		tfail("unexpected block data");
+
+	rel_cb(iop);
 }
 
 static void
 t17()
 {
-	state = 1;
+	thr_started();
 	test17_val();
 }
 
@@ -1246,7 +1195,7 @@ test17(char *fname)
 	struct iocb **ioq;
 	pthread_t tid;
 
-	tc = 17;
+	tc = test_case("aio", 17);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1258,8 +1207,7 @@ test17(char *fname)
 	/* start thread and block for event before submit */
 	state = 0;
 	pthread_create(&tid, NULL, (void *(*)(void *))t17, (void *)NULL);
-	while (state == 0)
-		nanosleep(&delay, NULL);
+	wait_thr_blocked();
 
 	ioq = (struct iocb **)malloc(sizeof (struct iocb *) * NPAR);
 	if (ioq == NULL)
@@ -1289,7 +1237,7 @@ t18()
 	struct io_event events[NPAR];
 	int rc;
 
-	state = 1;
+	thr_started();
 	rc = io_getevents(gctx, NPAR, NPAR, events, NULL);
 	/* We're being interrupted - should get 0 or 1 event */
 	if (rc != 0 && rc != 1)
@@ -1307,7 +1255,7 @@ test18(char *fname)
 	struct iocb **ioq;
 	pthread_t tid;
 
-	tc = 18;
+	tc = test_case("aio", 18);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1328,9 +1276,7 @@ test18(char *fname)
 
 	state = 0;
 	pthread_create(&tid, NULL, (void *(*)(void *))t18, (void *)NULL);
-
-	while (state == 0)
-		nanosleep(&delay, NULL);
+	wait_thr_blocked();
 
 	rc = io_destroy(gctx);
 	if (rc != 0)
@@ -1347,7 +1293,7 @@ t19()
 {
 	struct io_event events[128];
 
-	state = 1;
+	thr_started();
 	(void) io_getevents(gctx, 128, 128, events, NULL);
 	exit(0);
 }
@@ -1365,7 +1311,7 @@ test19(char *fname)
 	int rc;
 	pthread_t tid;
 
-	tc = 19;
+	tc = test_case("aio", 19);
 	gctx = 0;
 	rc = io_setup(128, &gctx);
 	if (rc < 0)
@@ -1373,9 +1319,7 @@ test19(char *fname)
 
 	state = 0;
 	pthread_create(&tid, NULL, (void *(*)(void *))t19, (void *)NULL);
-
-	while (state == 0)
-		nanosleep(&delay, NULL);
+	wait_thr_blocked();
 
 	rc = io_destroy(gctx);
 	if (rc != 0)
@@ -1390,7 +1334,7 @@ t20()
 {
 	struct io_event events[128];
 
-	state = 1;
+	thr_started();
 	(void) io_getevents(gctx, 128, 128, events, NULL);
 }
 
@@ -1406,7 +1350,7 @@ test20(char *fname)
 	int rc;
 	pthread_t tid;
 
-	tc = 20;
+	tc = test_case("aio", 20);
 	gctx = 0;
 	rc = io_setup(128, &gctx);
 	if (rc < 0)
@@ -1414,9 +1358,7 @@ test20(char *fname)
 
 	state = 0;
 	pthread_create(&tid, NULL, (void *(*)(void *))t20, (void *)NULL);
-
-	while (state == 0)
-		nanosleep(&delay, NULL);
+	wait_thr_blocked();
 
 	exit(0);
 }
@@ -1426,7 +1368,7 @@ t21()
 {
 	struct io_event events[NPAR];
 
-	state = 1;
+	thr_started();
 	(void) io_getevents(gctx, NPAR, NPAR, events, NULL);
 }
 
@@ -1446,9 +1388,9 @@ test21(void *a)
 	pthread_t tid;
 
 	if (flag == 0) {
-		tc = 21;
+		tc = test_case("aio", 21);
 	} else {
-		tc = 22;
+		tc = test_case("aio", 22);
 	}
 	gctx = 0;
 	rc = io_setup(NPAR, &gctx);
@@ -1457,9 +1399,7 @@ test21(void *a)
 
 	state = 0;
 	pthread_create(&tid, NULL, (void *(*)(void *))t21, (void *)NULL);
-
-	while (state == 0)
-		nanosleep(&delay, NULL);
+	wait_thr_blocked();
 
 	if (flag == 0) {
 		kill(getpid(), SIGKILL);
@@ -1482,7 +1422,7 @@ test23(char *fname)
 	struct timespec timeout = { 0, 0 };
 	struct io_event events[NPAR];
 
-	tc = 23;
+	tc = test_case("aio", 23);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1531,7 +1471,7 @@ test24(char *fname)
 	struct io_event events[NPAR];
 	struct timespec timeout = { 0, 0 };
 
-	tc = 24;
+	tc = test_case("aio", 24);
 	ctx = 0;
 	rc = io_setup(NPAR, &ctx);
 	if (rc < 0)
@@ -1566,7 +1506,7 @@ test25(char *fname)
 	int rc;
 	struct io_event events[NPAR];
 
-	tc = 25;
+	tc = test_case("aio", 25);
 	ctx = 0;
 	rc = io_setup(NPAR, &ctx);
 	if (rc < 0)
@@ -1595,19 +1535,15 @@ test26(char *fname)
 	struct iocb **ioq;
 	struct io_event events[NPAR];
 	struct iocb *io;
-	pthread_t tid;
-
-	tc = 26;
-	state = 0;
-	pthread_create(&tid, NULL, (void *(*)(void *))tsrv, (void *)NULL);
-
-	while (state == 0)
-                nanosleep(&delay, NULL);
+	int sfd[2];
 
+	tc = test_case("aio", 26);
 	if ((fd0 = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd0, errno);
 
-	fd1 = setup_sock();
+	if (loopback_pair(-1, sfd) != 0)
+		t_err("loopback_pair", -1, errno);
+	fd1 = sfd[0];
 
 	ctx = 0;
 	rc = io_setup(NPAR, &ctx);
@@ -1646,21 +1582,18 @@ test26(char *fname)
 		} else {
 			if (ep->res != BLKSIZE)
 				tfail("unexpected res");
-			free((void *)iop->aio_buf);
 		}
 
-		free(iop);
+		rel_cb(iop);
 	}
 
-	state = 2;
 	rc = io_destroy(ctx);
 	if (rc != 0)
 		t_err("destroy", rc, errno);
 
-	pthread_join(tid, NULL);
-
 	close(fd0);
-	close(fd1);
+	close(sfd[0]);
+	close(sfd[1]);
 	return (0);
 }
 
@@ -1671,7 +1604,7 @@ t27()
 	struct io_event events[NPAR];
 	struct timespec timeout = { 0, 10000 };
 
-	state = 1;
+	rdv_set(&state, 1);
 	while (gztot != NPAR) {
 		struct io_event *ep = &events[0];
 		struct iocb *iop;
@@ -1682,11 +1615,9 @@ t27()
 		if (rc == 1) {
 
 			iop = (struct iocb *)ep->obj;
-			free((void *)iop->aio_buf);
-			free(iop);
-			gztot++;
+			rel_cb(iop);
+			__sync_fetch_and_add(&gztot, 1);
 		}
-                nanosleep(&delay, NULL);
 	}
 }
 
@@ -1703,7 +1634,7 @@ test27(char *fname)
 	struct timespec timeout = { 0, 10000 };
 	pthread_t tid;
 
-	tc = 27;
+	tc = test_case("aio", 27);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1729,8 +1660,8 @@ test27(char *fname)
 		t_err("submit", rc, errno);
 
 	/* wait for thread to be running */
-	while (state == 0)
-		nanosleep(&delay, NULL);
+	if (rdv_wait_ne(&state, 0) != 0)
+		t_err("thread start", -1, errno);
 
 	while (gztot != NPAR) {
 		struct io_event *ep = &events[0];
@@ -1741,11 +1672,9 @@ test27(char *fname)
 			t_err("getevents", rc, errno);
 		if (rc == 1) {
 			iop = (struct iocb *)ep->obj;
-			free((void *)iop->aio_buf);
-			free(iop);
-			gztot++;
+			rel_cb(iop);
+			__sync_fetch_and_add(&gztot, 1);
 		}
-                nanosleep(&delay, NULL);
 	}
 
 	pthread_join(tid, NULL);
@@ -1770,7 +1699,7 @@ test28(char *fname)
 	int rc, i;
 	char *p;
 
-	tc = 28;
+	tc = test_case("aio", 28);
 	ctx = 0;
 	rc = io_setup(NPAR, &ctx);
 	if (rc < 0)
@@ -1796,7 +1725,7 @@ t29()
 	int rc;
 	struct io_event events[3 * NPAR];
 
-	state = 1;
+	rdv_set(&state, 1);
 	while (gztot != 0) {
 		int i;
 		uint64_t u;
@@ -1815,8 +1744,7 @@ t29()
 			iop = (struct iocb *)ep->obj;
 			if (ep->res != BLKSIZE)
 				tfail("unexpected res");
-			free((void *)iop->aio_buf);
-			free(iop);
+			rel_cb(iop);
 		}
 
 		gztot -= rc;
@@ -1835,7 +1763,7 @@ test29(char *fname)
 	struct iocb **ioq;
 	pthread_t tid;
 
-	tc = 29;
+	tc = test_case("aio", 29);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1847,8 +1775,8 @@ test29(char *fname)
 	pthread_create(&tid, NULL, (void *(*)(void *))t29, (void *)NULL);
 
 	/* wait for thread to be running */
-	while (state < 1)
-                nanosleep(&delay, NULL);
+	if (rdv_wait_ne(&state, 0) != 0)
+		t_err("thread start", -1, errno);
 
 	gctx = 0;
 	rc = io_setup(3 * NPAR, &gctx);
@@ -1896,7 +1824,7 @@ test30(char *fname)
 	struct iocb **ioq;
 	aio_context_t ctx;
 
-	tc = 30;
+	tc = test_case("aio", 30);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -1945,7 +1873,7 @@ test31(char *fname)
 	int rc, i;
 	aio_context_t ctx, ctxa[512];
 
-	tc = 31;
+	tc = test_case("aio", 31);
 
 	for (i = 0; i < 512; i++) {
 		ctxa[i] = 0;
@@ -1986,7 +1914,7 @@ test32(char *fname)
 	aio_context_t ctx;
 	struct io_event events[NPAR];
 
-	tc = 32;
+	tc = test_case("aio", 32);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -2020,7 +1948,9 @@ test32(char *fname)
 
 	pid = vfork();
 	if (pid == 0)
-		exit(0);
+		_exit(0);
+
+	waitpid(pid, &status, 0);
 
 	/* Ensure worker threads are still running after the vfork */
 	rc = io_submit(ctx, NPAR, ioq);
@@ -2035,11 +1965,23 @@ test32(char *fname)
 	if (rc != 0)
 		t_err("destroy", rc, errno);
 
+	for (i = 0; i < NPAR; i++)
+		rel_cb(ioq[i]);
+	free(ioq);
 	close(fd);
-	close(evfd);
 	return (0);
 }
 
+static void
+t33_fail(siginfo_t *sip)
+{
+	char e[80];
+
+	snprintf(e, sizeof (e), "code: %d status: %d", sip->si_code,
+	    sip->si_status);
+	tfail(e);
+}
+
 /*
  * Test various signals sent to a child process waiting on aio.
  */
@@ -2067,7 +2009,7 @@ test33(char *fname)
 		{0, 0},
 	};
 
-	tc = 33;
+	tc = test_case("aio", 33);
 	for (i = 0; sr[i].sr_sig != 0; i++) {
 		int pid;
 		siginfo_t si;
@@ -2086,14 +2028,23 @@ test33(char *fname)
 			if ((rc = io_setup(NPAR, &ctx)) < 0)
 				t_err("setup", rc, errno);
 
-			/* block forever */
-			rc = io_getevents(ctx, NPAR, NPAR, events, NULL);
+			/*
+			 * Block forever. A stop and continue interrupts
+			 * io_getevents on Linux, so go back to waiting.
+			 */
+			while ((rc = io_getevents(ctx, NPAR, NPAR, events,
+			    NULL)) < 0 && errno == EINTR)
+				;
 
 			/* we should never return from io_getevents */
 			tfail("returned");
 		}
 
-		nanosleep(&delay, NULL);
+		/* wait for the child to block in io_getevents */
+		if (rdv_blocked(pid) != 0) {
+			(void) kill(pid, SIGKILL);
+			t_err("child block", -1, errno);
+		}
 
 		(void) kill(pid, sr[i].sr_sig);
 
@@ -2108,25 +2059,19 @@ test33(char *fname)
 		if (sr[i].sr_flag & TST_KILL) {
 			if (si.si_code != CLD_KILLED ||
 			    si.si_status != sr[i].sr_sig) {
-				printf("FAIL aio %d, code: %d status: %d\n",
-				    tc, si.si_code, si.si_status);
-				exit(1);
+				t33_fail(&si);
 			}
 
 		} else if (sr[i].sr_flag & TST_CORE) {
 			if (si.si_code != CLD_DUMPED ||
 			    si.si_status != sr[i].sr_sig) {
-				printf("FAIL aio %d, code: %d status: %d\n",
-				    tc, si.si_code, si.si_status);
-				exit(1);
+				t33_fail(&si);
 			}
 
 		} else if (sr[i].sr_flag & TST_STOP) {
 			if (si.si_code != CLD_STOPPED ||
 			    si.si_status != sr[i].sr_sig) {
-				printf("FAIL aio %d, code: %d status: %d\n",
-				    tc, si.si_code, si.si_status);
-				exit(1);
+				t33_fail(&si);
 			}
 
 			if (sr[i].sr_flag & TST_STP_CONT) {
@@ -2135,10 +2080,7 @@ test33(char *fname)
 				    WEXITED | WSTOPPED | WCONTINUED);
 				if (si.si_code != CLD_CONTINUED ||
 				    si.si_status != SIGCONT) {
-					printf("FAIL aio %d, code: %d "
-					    "status: %d\n",
-					    tc, si.si_code, si.si_status);
-					exit(1);
+					t33_fail(&si);
 				}
 			}
 
@@ -2148,17 +2090,12 @@ test33(char *fname)
 			waitid(P_PID, pid, &si, WEXITED | WSTOPPED);
 			if (si.si_code != CLD_KILLED ||
 			    si.si_status != SIGKILL) {
-				printf("FAIL aio %d, code: %d "
-				    "status: %d\n",
-				    tc, si.si_code, si.si_status);
-				exit(1);
+				t33_fail(&si);
 			}
 
 		} else if (sr[i].sr_flag & TST_IGN) {
 			if (si.si_code != 0 || si.si_status != 0) {
-				printf("FAIL aio %d, code: %d status: %d\n",
-				    tc, si.si_code, si.si_status);
-				exit(1);
+				t33_fail(&si);
 			}
 
 			/* kill it now */
@@ -2166,10 +2103,7 @@ test33(char *fname)
 			waitid(P_PID, pid, &si, WEXITED | WSTOPPED);
 			if (si.si_code != CLD_KILLED ||
 			    si.si_status != SIGKILL) {
-				printf("FAIL aio %d, code: %d "
-				    "status: %d\n",
-				    tc, si.si_code, si.si_status);
-				exit(1);
+				t33_fail(&si);
 			}
 		}
 	}
@@ -2202,7 +2136,7 @@ test34(char *fname)
 	struct iocb **ioq;
 	pthread_t tid;
 
-	tc = 34;
+	tc = test_case("aio", 34);
 	if ((fd = open(fname, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -2246,6 +2180,626 @@ test34(char *fname)
 }
 
 
+/* Check a completed read of block ep->data of the test file */
+static void
+ring_check(struct io_event *ep)
+{
+	struct iocb *iop = (struct iocb *)ep->obj;
+	int n = (int)ep->data;
+
+	if (n < 0 || n >= BIG_FILE)
+		tfail("unexpected data tag");
+	if (ep->res != BLKSIZE)
+		tfail("unexpected res");
+	if (iop->aio_offset != (n * BLKSIZE))
+		tfail("unexpected offset");
+	if (crc32c(0, (char *)iop->aio_buf, BLKSIZE) != blk_crc[n])
+		tfail("unexpected block data");
+}
+
+static volatile int ring_seen[BIG_FILE];
+
+/* Reap from the ring alone until every read has been seen */
+static void
+t35()
+{
+	struct io_event events[NPAR];
+	int i, n;
+
+	while (gztot < BIG_FILE) {
+		if ((n = aio_ring_reap(gctx, NPAR, events)) < 0)
+			t_err("ring reap", n, errno);
+		if (n == 0) {
+			sched_yield();
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			ring_check(&events[i]);
+			__sync_fetch_and_add(&ring_seen[events[i].data], 1);
+			rel_cb((struct iocb *)events[i].obj);
+		}
+		__sync_fetch_and_add(&gztot, n);
+	}
+}
+
+/*
+ * Reap completions from the ring which Linux maps at the context, as libaio
+ * does: first on one thread, falling back to io_getevents() to wait, and then
+ * with several threads reaping the ring at once, each of which must see
+ * different completions.
+ */
+static int
+test35(char *fname)
+{
+	int fd, rc, i, n;
+	struct iocb **ioq;
+	struct io_event events[NPAR];
+	pthread_t tids[RING_THREADS];
+
+	tc = test_case("aio", 35);
+	if ((fd = open(fname, O_RDONLY)) < 0)
+		t_err("open", fd, errno);
+
+	gctx = 0;
+	rc = io_setup(BIG_FILE, &gctx);
+	if (rc < 0)
+		t_err("setup", rc, errno);
+
+	if (!aio_ring_usable(gctx)) {
+		/* lx doesn't emulate the ring; see test28 */
+		if (!is_lx)
+			tfail("no completion ring");
+		(void) io_destroy(gctx);
+		close(fd);
+		return (0);
+	}
+
+	ioq = (struct iocb **)malloc(sizeof (struct iocb *) * BIG_FILE);
+	if (ioq == NULL)
+		tfail("out of memory");
+
+	for (i = 0; i < NPAR; i++)
+		ioq[i] = mk_cb(fd, IOCB_CMD_PREAD, i * BLKSIZE, (long)i);
+	rc = io_submit(gctx, NPAR, ioq);
+	if (rc != NPAR)
+		t_err("submit", rc, errno);
+
+	for (n = 0; n < NPAR; n += rc) {
+		rc = aio_ring_getevents(gctx, 1, NPAR - n, events, NULL);
+		if (rc < 1)
+			t_err("ring getevents", rc, errno);
+		for (i = 0; i < rc; i++) {
+			ring_check(&events[i]);
+			rel_cb((struct iocb *)events[i].obj);
+		}
+	}
+
+	/* Nothing is left, so this mustn't find anything */
+	if ((rc = aio_ring_reap(gctx, NPAR, events)) != 0)
+		t_err("empty ring reap", rc, errno);
+
+	gztot = 0;
+	for (i = 0; i < BIG_FILE; i++)
+		ring_seen[i] = 0;
+	for (i = 0; i < RING_THREADS; i++)
+		pthread_create(&tids[i], NULL, (void *(*)(void *))t35, NULL);
+
+	for (i = 0; i < BIG_FILE; i++)
+		ioq[i] = mk_cb(fd, IOCB_CMD_PREAD, i * BLKSIZE, (long)i);
+	for (n = 0; n < BIG_FILE; n += rc) {
+		rc = io_submit(gctx, BIG_FILE - n, ioq + n);
+		if (rc < 1)
+			t_err("submit", rc, errno);
+	}
+
+	for (i = 0; i < RING_THREADS; i++)
+		pthread_join(tids[i], NULL);
+
+	for (i = 0; i < BIG_FILE; i++) {
+		if (ring_seen[i] != 1)
+			t_err("block reaped", i, ring_seen[i]);
+	}
+
+	rc = io_destroy(gctx);
+	if (rc != 0)
+		t_err("destroy", rc, errno);
+
+	free(ioq);
+	close(fd);
+	return (0);
+}
+
+
+/* Fill 'n' iovecs of the given lengths with separately allocated buffers */
+static void
+vec_alloc(struct iovec *iov, int n, size_t *lens)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		iov[i].iov_len = lens[i];
+		if ((iov[i].iov_base = malloc(lens[i])) == NULL)
+			tfail("out of memory");
+	}
+}
+
+static void
+vec_free(struct iovec *iov, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		free(iov[i].iov_base);
+}
+
+/* Submit one vectored iocb and check that it moved 'len' bytes */
+static void
+vec_io(int fd, int op, off_t off, struct iovec *iov, int n, size_t len)
+{
+	struct iocb *io;
+	struct io_event event;
+	int rc;
+
+	io = mk_cb(fd, op, off, (long)n);
+	io->aio_buf = (__u64)iov;
+	io->aio_nbytes = n;
+
+	rc = io_submit(gctx, 1, &io);
+	if (rc != 1)
+		t_err(op == IOCB_CMD_PWRITEV ? "pwritev submit" :
+		    "preadv submit", rc, errno);
+	rc = io_getevents(gctx, 1, 1, &event, NULL);
+	if (rc != 1)
+		t_err("getevents", rc, errno);
+	if (event.data != n || event.res != len)
+		t_err("unexpected res", (int)event.res, n);
+	rel_cb(io);
+}
+
+/*
+ * Test IOCB_CMD_PWRITEV and IOCB_CMD_PREADV with from 1 to VEC_MAX iovecs.
+ * Pattern data is gathered from separate buffers by the write, and scattered
+ * over buffers split at different places by the read, and both what's read
+ * back and the file itself must hold the pattern.
+ */
+static int
+test36(char *fname)
+{
+	static const int counts[] = { 1, 2, 7, 64, VEC_MAX, 0 };
+	struct iovec *wiov, *riov;
+	size_t *lens, len, pos;
+	char vfile[100], *pat, *buf;
+	off_t off = 0;
+	int fd, rc, c, i, n;
+
+	tc = test_case("aio", 36);
+	snprintf(vfile, sizeof (vfile), "%s.v", fname);
+	if ((fd = open(vfile, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+		t_err("open", fd, errno);
+
+	gctx = 0;
+	rc = io_setup(1, &gctx);
+	if (rc < 0)
+		t_err("setup", rc, errno);
+
+	wiov = calloc(VEC_MAX, sizeof (struct iovec));
+	riov = calloc(VEC_MAX, sizeof (struct iovec));
+	lens = calloc(VEC_MAX, sizeof (size_t));
+	if (wiov == NULL || riov == NULL || lens == NULL)
+		tfail("out of memory");
+
+	for (c = 0; counts[c] != 0; c++) {
+		n = counts[c];
+
+		/* Write buffers of 1, 2 or 3 blocks */
+		for (i = 0, len = 0; i < n; i++) {
+			lens[i] = BLKSIZE * (1 + i % 3);
+			len += lens[i];
+		}
+		vec_alloc(wiov, n, lens);
+		if ((pat = malloc(len)) == NULL || (buf = malloc(len)) == NULL)
+			tfail("out of memory");
+		pattern_fill(pat, len, off);
+		for (i = 0, pos = 0; i < n; pos += lens[i], i++)
+			memcpy(wiov[i].iov_base, pat + pos, lens[i]);
+
+		vec_io(fd, IOCB_CMD_PWRITEV, off, wiov, n, len);
+
+		/* Read into equal buffers, with the odd bytes in the last */
+		for (i = 0; i < n; i++)
+			lens[i] = (len / n) & ~7;
+		lens[n - 1] = len - (n - 1) * lens[0];
+		vec_alloc(riov, n, lens);
+
+		vec_io(fd, IOCB_CMD_PREADV, off, riov, n, len);
+
+		for (i = 0, pos = 0; i < n; pos += lens[i], i++)
+			memcpy(buf + pos, riov[i].iov_base, lens[i]);
+		if (pattern_check(buf, len, off) != 0)
+			t_err("preadv data", n, 0);
+
+		if ((rc = pread(fd, buf, len, off)) != len)
+			t_err("pread", rc, errno);
+		if (pattern_check(buf, len, off) != 0)
+			t_err("pwritev data", n, 0);
+
+		vec_free(wiov, n);
+		vec_free(riov, n);
+		free(pat);
+		free(buf);
+		off += len;
+	}
+
+	rc = io_destroy(gctx);
+	if (rc != 0)
+		t_err("destroy", rc, errno);
+
+	free(wiov);
+	free(riov);
+	free(lens);
+	close(fd);
+	unlink(vfile);
+	return (0);
+}
+
+
+/* Submit a poll for 'events' on 'fd' */
+static struct iocb *
+poll_cb(int fd, int events, long data)
+{
+	struct iocb *io;
+	int rc;
+
+	io = mk_cb(fd, IOCB_CMD_POLL, 0, data);
+	io->aio_buf = events;
+	io->aio_nbytes = 0;
+
+	rc = io_submit(gctx, 1, &io);
+	if (rc != 1)
+		t_err("poll submit", rc, errno);
+	return (io);
+}
+
+/* Check that no poll has completed yet */
+static void
+poll_pending()
+{
+	struct io_event event;
+	struct timespec timeout = { 0, 0 };
+	int rc;
+
+	rc = io_getevents(gctx, 0, 1, &event, &timeout);
+	if (rc != 0)
+		t_err("poll completed early", rc, errno);
+}
+
+/* Wait for a poll to complete, reporting at least 'revents' */
+static void
+poll_done(struct iocb *io, int revents)
+{
+	struct io_event event;
+	struct timespec timeout = { 5, 0 };
+	int rc;
+
+	rc = io_getevents(gctx, 1, 1, &event, &timeout);
+	if (rc != 1)
+		t_err("poll getevents", rc, errno);
+	if (event.obj != (__u64)io)
+		tfail("unexpected poll iocb");
+	if ((event.res & revents) != revents)
+		t_err("poll revents", (int)event.res, revents);
+	rel_cb(io);
+}
+
+/*
+ * Test IOCB_CMD_POLL on a pipe, an eventfd, an AF_UNIX socket pair and a TCP
+ * loopback connection. A poll for input mustn't complete until something is
+ * written, and a poll for output on an fd with room must complete at once.
+ * Closing the write end of a pipe must complete a poll of the read end.
+ */
+static int
+test37(char *fname)
+{
+	int fds[4][2], i, rc, efd;
+	struct iocb *io;
+	uint64_t v = 1;
+	char c = 'x';
+
+	tc = test_case("aio", 37);
+	gctx = 0;
+	rc = io_setup(NPAR, &gctx);
+	if (rc < 0)
+		t_err("setup", rc, errno);
+
+	if (pipe(fds[0]) != 0)
+		t_err("pipe", -1, errno);
+	if ((efd = eventfd(0, 0)) < 0)
+		t_err("eventfd", efd, errno);
+	fds[1][0] = fds[1][1] = efd;
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[2]) != 0)
+		t_err("socketpair", -1, errno);
+	if (loopback_pair(-1, fds[3]) != 0)
+		t_err("loopback", -1, errno);
+
+	for (i = 0; i < 4; i++) {
+		io = poll_cb(fds[i][0], POLLIN, i);
+		poll_pending();
+		if (i == 1)
+			rc = write(fds[i][1], &v, sizeof (v));
+		else
+			rc = write(fds[i][1], &c, 1);
+		if (rc <= 0)
+			t_err("write", rc, errno);
+		poll_done(io, POLLIN);
+
+		if (i == 1)
+			rc = read(fds[i][0], &v, sizeof (v));
+		else
+			rc = read(fds[i][0], &c, 1);
+		if (rc <= 0)
+			t_err("read", rc, errno);
+
+		io = poll_cb(fds[i][1], POLLOUT, i);
+		poll_done(io, POLLOUT);
+	}
+
+	io = poll_cb(fds[0][0], POLLIN, 0);
+	poll_pending();
+	close(fds[0][1]);
+	poll_done(io, POLLHUP);
+
+	rc = io_destroy(gctx);
+	if (rc != 0)
+		t_err("destroy", rc, errno);
+
+	close(fds[0][0]);
+	close(efd);
+	for (i = 2; i < 4; i++) {
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+	return (0);
+}
+
+
+/* Do one block of I/O with 'flags' in aio_rw_flags, returning its result */
+static long long
+flag_io(int fd, int op, off_t off, int flags, char *data)
+{
+	struct iocb *io;
+	struct io_event event;
+	struct timespec timeout = { 5, 0 };
+	long long res;
+	int rc;
+
+	io = mk_cb(fd, op, off, 0);
+	io->aio_rw_flags = flags;
+	if (op == IOCB_CMD_PWRITE)
+		memcpy((void *)(uintptr_t)io->aio_buf, data, BLKSIZE);
+
+	rc = io_submit(gctx, 1, &io);
+	if (rc != 1) {
+		rel_cb(io);
+		return (-errno);
+	}
+	rc = io_getevents(gctx, 1, 1, &event, &timeout);
+	if (rc != 1)
+		t_err("flags getevents", rc, errno);
+	res = event.res;
+	if (op == IOCB_CMD_PREAD && res == BLKSIZE)
+		memcpy(data, (void *)(uintptr_t)io->aio_buf, BLKSIZE);
+	rel_cb(io);
+	return (res);
+}
+
+/*
+ * Test per-iocb aio_rw_flags. RWF_DSYNC writes must land where they're
+ * pointed, RWF_APPEND writes at the end of the file whatever the offset, and
+ * RWF_HIPRI is accepted. An RWF_NOWAIT read of a block that isn't in the page
+ * cache must complete with EAGAIN rather than block, and must succeed once the
+ * block has been read in; filesystems such as tmpfs which can't do RWF_NOWAIT
+ * reads refuse them with EOPNOTSUPP, and those checks are skipped. Flags Linux
+ * doesn't know of make io_submit() fail with EOPNOTSUPP.
+ */
+static int
+test38(char *fname)
+{
+	char ffile[100], buf[BLKSIZE], data[BLKSIZE];
+	struct stat st;
+	long long res;
+	int fd, rc, i;
+
+	tc = test_case("aio", 38);
+	snprintf(ffile, sizeof (ffile), "%s.f", fname);
+	if ((fd = open(ffile, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+		t_err("open", fd, errno);
+
+	gctx = 0;
+	rc = io_setup(1, &gctx);
+	if (rc < 0)
+		t_err("setup", rc, errno);
+
+	for (i = 0; i < FILE_BLOCKS; i++) {
+		pattern_fill(buf, BLKSIZE, i * BLKSIZE);
+		if ((rc = pwrite(fd, buf, BLKSIZE, i * BLKSIZE)) != BLKSIZE)
+			t_err("pwrite", rc, errno);
+	}
+
+	pattern_fill(data, BLKSIZE, 0);
+	if ((res = flag_io(fd, IOCB_CMD_PWRITE, 0, RWF_DSYNC, data)) != BLKSIZE)
+		t_err("dsync write", (int)res, 0);
+	if ((rc = pread(fd, buf, BLKSIZE, 0)) != BLKSIZE)
+		t_err("pread", rc, errno);
+	if (pattern_check(buf, BLKSIZE, 0) != 0)
+		tfail("dsync write data");
+
+	pattern_fill(data, BLKSIZE, FILE_BLOCKS * BLKSIZE);
+	res = flag_io(fd, IOCB_CMD_PWRITE, 0, RWF_APPEND, data);
+	if (res != BLKSIZE)
+		t_err("append write", (int)res, 0);
+	if (fstat(fd, &st) != 0)
+		t_err("fstat", -1, errno);
+	if (st.st_size != (FILE_BLOCKS + 1) * BLKSIZE)
+		t_err("append size", (int)st.st_size, 0);
+	for (i = 0; i <= FILE_BLOCKS; i++) {
+		if ((rc = pread(fd, buf, BLKSIZE, i * BLKSIZE)) != BLKSIZE)
+			t_err("pread", rc, errno);
+		if (pattern_check(buf, BLKSIZE, i * BLKSIZE) != 0)
+			t_err("append data", i, 0);
+	}
+
+	if ((res = flag_io(fd, IOCB_CMD_PREAD, 0, RWF_HIPRI, buf)) != BLKSIZE)
+		t_err("hipri read", (int)res, 0);
+
+	/*
+	 * Push the file out of the page cache, so the read misses. Linux can
+	 * skip pages which it's still adding to the LRU, so try a few times.
+	 */
+	if (fsync(fd) != 0)
+		t_err("fsync", -1, errno);
+	for (i = 0; i < 100; i++) {
+		rc = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		if (rc != 0)
+			t_err("fadvise", -1, rc);
+		res = flag_io(fd, IOCB_CMD_PREAD, BLKSIZE, RWF_NOWAIT, buf);
+		if (res != BLKSIZE)
+			break;
+		nanosleep(&delay, NULL);
+	}
+	if (res != -EAGAIN && res != -EOPNOTSUPP &&
+	    (!is_lx || res != BLKSIZE))
+		t_err("nowait miss", (int)res, 0);
+	if (res != -EOPNOTSUPP) {
+		if ((rc = pread(fd, buf, BLKSIZE, BLKSIZE)) != BLKSIZE)
+			t_err("pread", rc, errno);
+		res = flag_io(fd, IOCB_CMD_PREAD, BLKSIZE, RWF_NOWAIT, buf);
+		if (res != BLKSIZE)
+			t_err("nowait hit", (int)res, 0);
+		if (pattern_check(buf, BLKSIZE, BLKSIZE) != 0)
+			tfail("nowait read data");
+	}
+
+	res = flag_io(fd, IOCB_CMD_PREAD, 0, 0x40000000, buf);
+	if (res != -EOPNOTSUPP)
+		t_err("unknown flag", (int)res, 0);
+
+	rc = io_destroy(gctx);
+	if (rc != 0)
+		t_err("destroy", rc, errno);
+
+	close(fd);
+	unlink(ffile);
+	return (0);
+}
+
+
+static void
+count_sig(int sig)
+{
+	sig_count++;
+}
+
+/* Wait with SIGUSR1 blocked for the wait only */
+static void
+t39()
+{
+	struct io_event event;
+	sigset_t mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+
+	thr_started();
+	pget_rc = io_pgetevents(gctx, 1, 1, &event, NULL, &mask);
+}
+
+/*
+ * Test io_pgetevents(). With no mask it must behave as io_getevents(). A
+ * signal which is blocked but pending must interrupt it at once if the mask
+ * it's given unblocks the signal, with the handler run, so that nothing is
+ * lost in between unblocking and waiting. A signal sent to a thread which
+ * the mask blocks it in must neither interrupt it nor be handled until an
+ * event ends the wait.
+ */
+static int
+test39(char *fname)
+{
+	struct io_event event;
+	struct timespec timeout = { 0, 0 };
+	struct sigaction sa, osa;
+	sigset_t mask, omask;
+	struct iocb *io;
+	pthread_t tid;
+	int rc, fds[2];
+	char c = 'x';
+
+	tc = test_case("aio", 39);
+	gctx = 0;
+	rc = io_setup(NPAR, &gctx);
+	if (rc < 0)
+		t_err("setup", rc, errno);
+
+	memset(&sa, 0, sizeof (sa));
+	sa.sa_handler = count_sig;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGUSR1, &sa, &osa) != 0)
+		t_err("sigaction", -1, errno);
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &mask, &omask);
+
+	rc = io_pgetevents(gctx, 1, 1, &event, &timeout, NULL);
+	if (rc != 0)
+		t_err("pgetevents", rc, errno);
+
+	/* A pending signal, unblocked only for the wait */
+	sig_count = 0;
+	raise(SIGUSR1);
+	sigemptyset(&mask);
+	rc = io_pgetevents(gctx, 1, 1, &event, NULL, &mask);
+	if (rc != -1 || errno != EINTR)
+		t_err("pgetevents not interrupted", rc, errno);
+	if (sig_count != 1)
+		t_err("signal not handled", sig_count, 0);
+
+	/* A signal blocked for the wait */
+	if (pipe(fds) != 0)
+		t_err("pipe", -1, errno);
+	io = poll_cb(fds[0], POLLIN, 0);
+	sig_count = 0;
+	state = 0;
+	pthread_create(&tid, NULL, (void *(*)(void *))t39, (void *)NULL);
+	wait_thr_blocked();
+	if (syscall(SYS_tgkill, getpid(), thr_id, SIGUSR1) != 0)
+		t_err("tgkill", -1, errno);
+	nanosleep(&delay, NULL);
+	if (sig_count != 0)
+		tfail("signal handled during masked wait");
+	if (rdv_blocked(thr_id) != 0)
+		tfail("masked wait interrupted");
+	if (write(fds[1], &c, 1) != 1)
+		t_err("write", -1, errno);
+	pthread_join(tid, NULL);
+	if (pget_rc != 1)
+		t_err("masked pgetevents", pget_rc, 0);
+	if (sig_count != 1)
+		t_err("signal not handled after wait", sig_count, 0);
+	rel_cb(io);
+
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+	sigaction(SIGUSR1, &osa, NULL);
+
+	rc = io_destroy(gctx);
+	if (rc != 0)
+		t_err("destroy", rc, errno);
+
+	close(fds[0]);
+	close(fds[1]);
+	return (0);
+}
+
+
 int
 main(int argc, char **argv)
 {
@@ -2259,42 +2813,83 @@ main(int argc, char **argv)
 	if (strstr(nm.version, "BrandZ") != NULL)
 		is_lx = 1;
 
-	test1(tst_file);
-	test2(tst_file, 2);
-	test2(tst_file, 3);
-	test2(tst_file, 4);
-	test5(tst_file);
-	test6(tst_file);
-	test7(tst_file);
-	if (is_lx)	/* fsync fails on Linux with EINVAL  */
+	if ((gpool = aio_pool_create(POOL_SLOTS, BLKSIZE, 0)) == NULL)
+		return (test_fail("aio", "can't create the iocb pool"));
+
+	if (test_selected(1))
+		test1(tst_file);
+	if (test_selected(2))
+		test2(tst_file, 2);
+	if (test_selected(3))
+		test2(tst_file, 3);
+	if (test_selected(4))
+		test2(tst_file, 4);
+	if (test_selected(5))
+		test5(tst_file);
+	if (test_selected(6))
+		test6(tst_file);
+	if (test_selected(7))
+		test7(tst_file);
+	if (test_selected(8))
 		test8(tst_file);
-	test9(tst_file);
-	test10(tst_file);
-	test11(tst_file);
-	test12(tst_file);
-	test13(tst_file);
-	test14(tst_file);
-	test15(tst_file);
-	test16(tst_file);
-	test17(tst_file);
-	test18(tst_file);
+	if (test_selected(9))
+		test9(tst_file);
+	if (test_selected(10))
+		test10(tst_file);
+	if (test_selected(11))
+		test11(tst_file);
+	if (test_selected(12))
+		test12(tst_file);
+	if (test_selected(13))
+		test13(tst_file);
+	if (test_selected(14))
+		test14(tst_file);
+	if (test_selected(15))
+		test15(tst_file);
+	if (test_selected(16))
+		test16(tst_file);
+	if (test_selected(17))
+		test17(tst_file);
+	if (test_selected(18))
+		test18(tst_file);
 	run_as_proc(19, test19, tst_file);
 	run_as_proc(20, test20, tst_file);
 	run_as_proc(21, test21, (void *)0);
 	run_as_proc(22, test21, (void *)1);
-	test23(tst_file);
-	test24(tst_file);
-	test25(tst_file);
-	test26(tst_file);
-	test27(tst_file);
-	test28(tst_file);
-	test29(tst_file);
-	test30(tst_file);
-	test31(tst_file);
-	test32(tst_file);
+	if (test_selected(23))
+		test23(tst_file);
+	if (test_selected(24))
+		test24(tst_file);
+	if (test_selected(25))
+		test25(tst_file);
+	if (test_selected(26))
+		test26(tst_file);
+	if (test_selected(27))
+		test27(tst_file);
+	if (test_selected(28))
+		test28(tst_file);
+	if (test_selected(29))
+		test29(tst_file);
+	if (test_selected(30))
+		test30(tst_file);
+	if (test_selected(31))
+		test31(tst_file);
+	if (test_selected(32))
+		test32(tst_file);
 	run_as_proc(33, test33, tst_file);
 	run_as_proc(34, test34, tst_file);
+	if (test_selected(35))
+		test35(tst_file);
+	if (test_selected(36))
+		test36(tst_file);
+	if (test_selected(37))
+		test37(tst_file);
+	if (test_selected(38))
+		test38(tst_file);
+	if (test_selected(39))
+		test39(tst_file);
 
 	unlink(tst_file);
+	aio_pool_destroy(gpool);
 	return (test_pass("aio"));
 }
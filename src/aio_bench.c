@@ -0,0 +1,2296 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Benchmark Linux native aio as the queue depth, block size and number of
+ * threads submitting and reaping vary.
+ *
+ * For each point, 'qd' reads of 'bs' bytes at random block offsets in a file
+ * are kept in flight: as each read completes, its iocb is resubmitted at a new
+ * offset. The time from just before the io_submit() of a read until
+ * io_getevents() returns it is recorded, and the result line also shows the
+ * IOPS and MB/s achieved. This is done for the file opened normally, where
+ * the reads are served from the page cache, and opened with O_DIRECT.
+ *
+ * The benchmarks are named aio.qd.<buffered|direct>.<bs>.<qd>, e.g.
+ * aio.qd.direct.4k.32, so that e.g. "aio_bench aio.qd.direct" runs only the
+ * O_DIRECT sweep. Points with more than MAX_INFLIGHT bytes outstanding are
+ * left out. O_DIRECT is skipped where the filesystem doesn't support it.
+ *
+ * The aio.mt.<private|shared>.<threads> benchmarks measure how aio scales
+ * across CPUs. Each thread is pinned to its own CPU and keeps MT_QD 4k reads
+ * in flight in its own part of the file, through the page cache so that the
+ * cost of the aio paths rather than of the disk is what's measured. In the
+ * private variant each thread has its own context; in the shared variant all
+ * of them submit to and reap from one context, which shows whether
+ * submitters are serialized by the context's lock. The result line shows the
+ * aggregate IOPS and the IOPS per thread. The thread counts are powers of
+ * two up to the number of CPUs, or to LXTST_BENCH_AIO_THREADS.
+ *
+ * The aio.reap.<threads> benchmarks block from 1 to REAP_MAX threads in
+ * io_getevents() on one context and measure how long it takes one of them to
+ * return with a completion, how evenly the completions are spread over them,
+ * and how often they're woken for nothing; see run_reap().
+ *
+ * The aio.efd.<contexts>.<in flight> benchmarks run an epoll loop on an
+ * eventfd which every read signals through IOCB_FLAG_RESFD; see run_efd().
+ *
+ * The aio.ring.<syscall|ring>.<qd> benchmarks compare reaping with
+ * io_getevents() against reaping from the completion ring which Linux maps at
+ * the context, with the syscall only when the ring is empty; 'getevents_per_op'
+ * shows how many syscalls that saved.
+ *
+ * The aio.batch.<n> benchmarks time io_submit() of batches of 1 to BATCH_MAX
+ * iocbs, and aio.batch.fit splits the cost of a call into a fixed part and a
+ * part per iocb; see sweep_batch().
+ *
+ * The aio.vec.<pwrite|pwritev>.<segments> benchmarks compare gathering
+ * buffers into one IOCB_CMD_PWRITEV with writing them as separate iocbs.
+ *
+ * The aio.cancel.poll.<n> and aio.destroy.<poll|direct>.<n> benchmarks time
+ * io_cancel() and io_destroy() with up to KILL_MAX iocbs in flight.
+ *
+ * The aio.ready.<epoll|aio>.<connections> benchmarks compare socket
+ * readiness through IOCB_CMD_POLL with epoll_wait(); see run_ready().
+ *
+ * The aio.rwflags.<read|write>.<buffered|direct>.<flag>[.cold] benchmarks
+ * show what setting RWF_NOWAIT, RWF_HIPRI, RWF_DSYNC or RWF_APPEND in an
+ * iocb's aio_rw_flags costs, both in io_submit() and until the I/O
+ * completes, with the block read from the page cache or, for .cold, not;
+ * see run_rwflag().
+ *
+ * The aio.pgetevents.<nosig|masked|unmasked>.<reapers> benchmarks signal
+ * reapers blocked in io_pgetevents() just as their events complete, with the
+ * signal blocked or not while they wait, and count lost wakeups and signals;
+ * see run_pget().
+ *
+ * The aio.ctx.<nr_events> benchmarks make thousands of contexts, timing
+ * io_setup(), and show the memory and the share of aio-max-nr each takes up;
+ * see run_ctx().
+ *
+ * The iocbs and buffers come from an aio_pool_t, backed by huge pages where
+ * possible, so no allocation is done while measuring.
+ *
+ * The file is made in LXTST_BENCH_DIR, or the current directory, and is
+ * LXTST_BENCH_AIO_MB megabytes.
+ */
+
+#define	_GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include "lxtst.h"
+#include "lxaio.h"
+#include "lxbench.h"
+
+#define	MAX_QD		512
+#define	MAX_INFLIGHT	(64 * 1024 * 1024)
+#define	DFLT_FILE_MB	64
+
+#define	MT_QD		32	/* per thread */
+#define	MT_BS		4096
+#define	MT_POLL_NS	1000000	/* longest a reaper waits for an event */
+
+#define	REAP_MAX	64	/* the most reaper threads */
+#define	REAP_STOP	(~0ULL)	/* aio_data telling a reaper to exit */
+
+#define	EFD_MAX_INFLIGHT 4096
+
+#define	BATCH_MAX	512
+#define	BATCH_BS	512	/* small, so that the copying costs little */
+
+#define	VEC_MAX		256
+#define	VEC_SEG		4096
+
+#define	KILL_MAX	4096	/* the most iocbs to cancel or destroy */
+#define	KILL_MIN_RUNS	50	/* io_destroy() can take tens of milliseconds */
+
+#define	READY_MAX	256	/* the most loopback connections */
+
+#define	RWF_BS		4096
+#define	RWF_GROW_MAX	(64 * 1024 * 1024)	/* appended before truncating */
+
+#define	PGET_MAX	4	/* the most reapers in io_pgetevents() */
+#define	PGET_LOST_MS	100	/* a round this late has lost a wakeup */
+
+#define	CTX_MAX		4096	/* the most contexts made at each size */
+#define	CTX_NR_MAX	4096	/* the biggest nr_events */
+#define	CTX_DESTROYERS	64	/* threads destroying the contexts at once */
+
+/*
+ * The aio.rwflags points: which way, how the file is opened, the flag, and
+ * whether the file is dropped from the page cache before each read.
+ */
+static struct rwflag {
+	const char	*rf_name;
+	int		rf_op;
+	int		rf_oflags;
+	int		rf_flags;
+	int		rf_cold;
+} rwflags[] = {
+	{ "read.buffered.none", IOCB_CMD_PREAD, 0, 0, 0 },
+	{ "read.buffered.nowait", IOCB_CMD_PREAD, 0, RWF_NOWAIT, 0 },
+	{ "read.buffered.none.cold", IOCB_CMD_PREAD, 0, 0, 1 },
+	{ "read.buffered.nowait.cold", IOCB_CMD_PREAD, 0, RWF_NOWAIT, 1 },
+	{ "read.direct.none", IOCB_CMD_PREAD, O_DIRECT, 0, 0 },
+	{ "read.direct.hipri", IOCB_CMD_PREAD, O_DIRECT, RWF_HIPRI, 0 },
+	{ "write.buffered.none", IOCB_CMD_PWRITE, 0, 0, 0 },
+	{ "write.buffered.dsync", IOCB_CMD_PWRITE, 0, RWF_DSYNC, 0 },
+	{ "write.buffered.append", IOCB_CMD_PWRITE, 0, RWF_APPEND, 0 },
+	{ "write.direct.none", IOCB_CMD_PWRITE, O_DIRECT, 0, 0 },
+	{ "write.direct.dsync", IOCB_CMD_PWRITE, O_DIRECT, RWF_DSYNC, 0 },
+	{ NULL, 0, 0, 0, 0 }
+};
+
+static struct bsize {
+	size_t		bs_size;
+	const char	*bs_name;
+} bsizes[] = {
+	{ 512,		"512" },
+	{ 4096,		"4k" },
+	{ 65536,	"64k" },
+	{ 1048576,	"1m" },
+	{ 0,		NULL }
+};
+
+/*
+ * A thread of the multi-context benchmark. In the shared variant every
+ * worker's w_ctx and w_inflight point at the same context and count, and a
+ * worker may reap and resubmit another's iocbs, so each iocb's aio_data
+ * holds the number of the worker it belongs to as well as its slot.
+ */
+typedef struct worker {
+	pthread_t	w_tid;
+	int		w_num;
+	int		w_fd;
+	aio_context_t	*w_ctx;
+	volatile int	*w_inflight;
+	int		w_own_inflight;
+	aio_pool_t	*w_pool;
+	uint64_t	*w_start;	/* submission time of each slot */
+	off_t		w_base;		/* the file region this worker reads */
+	off_t		w_len;
+	uint64_t	w_rng;
+	bench_hist_t	*w_hist;
+	uint64_t	w_ops;
+	uint64_t	w_mstart;
+	uint64_t	w_mend;
+	pthread_barrier_t *w_barrier;
+	const char	*w_name;
+} worker_t;
+
+static worker_t *workers;
+static int ncpus;
+
+static char fpath[1024];
+static off_t fsize;
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+/* xorshift64 */
+static uint64_t
+rand_blk(uint64_t *rp, uint64_t nblks)
+{
+	*rp ^= *rp << 13;
+	*rp ^= *rp >> 7;
+	*rp ^= *rp << 17;
+	return (*rp % nblks);
+}
+
+static void
+make_file()
+{
+	char *dir, *s, *buf;
+	int fd;
+	off_t off;
+	size_t mb = DFLT_FILE_MB;
+
+	if ((dir = getenv("LXTST_BENCH_DIR")) == NULL || *dir == '\0')
+		dir = ".";
+	if ((s = getenv("LXTST_BENCH_AIO_MB")) != NULL && atoi(s) > 0)
+		mb = atoi(s);
+	fsize = (off_t)mb * 1024 * 1024;
+	(void) snprintf(fpath, sizeof (fpath), "%s/lxtmp-aio-bench.%d", dir,
+	    (int)getpid());
+
+	if ((buf = malloc(1024 * 1024)) == NULL)
+		bench_fail("aio", "out of memory");
+	if ((fd = open(fpath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		bench_fail("aio", "can't create the data file");
+
+	for (off = 0; off < fsize; off += 1024 * 1024) {
+		pattern_fill(buf, 1024 * 1024, off);
+		if (pwrite(fd, buf, 1024 * 1024, off) != 1024 * 1024) {
+			(void) unlink(fpath);
+			bench_fail("aio", "can't write the data file");
+		}
+	}
+	(void) fsync(fd);
+	(void) close(fd);
+	free(buf);
+}
+
+/* Why an I/O completed with 'res' rather than all it was asked to do */
+static const char *
+res_err(int64_t res, const char *what)
+{
+	return (res < 0 ? strerror((int)-res) : what);
+}
+
+/* Point an iocb at a new random block; its buffer and size stay the same */
+static void
+prep(struct iocb *cb, int fd, size_t bs)
+{
+	cb->aio_lio_opcode = IOCB_CMD_PREAD;
+	cb->aio_fildes = fd;
+	cb->aio_offset = rand_blk(&rng, fsize / bs) * bs;
+}
+
+/* Submit all of 'n' iocbs, stamping each with the time */
+static void
+submit(const char *name, aio_context_t ctx, uint64_t *start,
+    struct iocb **cbs, int n)
+{
+	uint64_t now = bench_now();
+	int i, rc;
+
+	for (i = 0; i < n; i++)
+		start[cbs[i]->aio_data] = now;
+
+	while (n > 0) {
+		if ((rc = io_submit(ctx, n, cbs)) < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			bench_fail(name, strerror(errno));
+		}
+		cbs += rc;
+		n -= rc;
+	}
+}
+
+/*
+ * Run one point of a sweep. Returns -1 if the reads can't be done with 'fd'
+ * opened O_DIRECT, as when 'bs' is smaller than the device's sectors.
+ */
+static int
+run_point(const char *name, int fd, int qd, size_t bs, int ring)
+{
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	uint64_t *start;
+	struct iocb **cbs;
+	struct io_event *evs;
+	bench_hist_t *hp;
+	uint64_t now, mstart, mend, ops = 0, reaped = 0, calls = 0;
+	int i, n, k, inflight, rc = 0;
+	double secs;
+
+	start = calloc(qd, sizeof (uint64_t));
+	cbs = calloc(qd, sizeof (struct iocb *));
+	evs = calloc(qd, sizeof (struct io_event));
+	if (start == NULL || cbs == NULL || evs == NULL)
+		bench_fail(name, "out of memory");
+	if ((pool = aio_pool_create(qd, bs, AIO_POOL_HUGE)) == NULL)
+		bench_fail(name, strerror(errno));
+	if ((hp = bench_hist_alloc()) == NULL)
+		bench_fail(name, "out of memory");
+	if (io_setup(qd, &ctx) < 0)
+		bench_fail(name, strerror(errno));
+	if (ring && !aio_ring_usable(ctx)) {
+		bench_skip(name, "the completion ring isn't mapped");
+		goto out;
+	}
+
+	for (i = 0; i < qd; i++) {
+		cbs[i] = aio_pool_get(pool);
+		cbs[i]->aio_data = aio_pool_slot(pool, cbs[i]);
+		prep(cbs[i], fd, bs);
+	}
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	submit(name, ctx, start, cbs, qd);
+	inflight = qd;
+
+	while (inflight > 0) {
+		/* With 'ring', only make the syscall if the ring is empty */
+		if (ring && (n = aio_ring_reap(ctx, qd, evs)) < 0)
+			bench_fail(name, strerror(errno));
+		if (!ring || n == 0) {
+			calls++;
+			if ((n = io_getevents(ctx, 1, qd, evs, NULL)) < 0) {
+				if (errno == EINTR)
+					continue;
+				bench_fail(name, strerror(errno));
+			}
+		}
+		now = bench_now();
+		inflight -= n;
+		reaped += n;
+
+		for (i = k = 0; i < n; i++) {
+			struct iocb *cb = (struct iocb *)(uintptr_t)evs[i].obj;
+
+			/* e.g. 512 byte O_DIRECT reads with 4k sectors */
+			if (evs[i].res == -EINVAL &&
+			    fcntl(fd, F_GETFL) & O_DIRECT) {
+				bench_skip(name, "O_DIRECT reads of this size "
+				    "are not supported here");
+				rc = -1;
+				goto out;
+			}
+			if (evs[i].res != bs)
+				bench_fail(name, res_err(evs[i].res,
+				    "short read"));
+			if (now >= mstart && now < mend) {
+				bench_hist_record(hp, now - start[evs[i].data]);
+				ops++;
+			}
+			if (now < mend) {
+				prep(cb, fd, bs);
+				cbs[k++] = cb;
+			}
+		}
+		if (k > 0) {
+			submit(name, ctx, start, cbs, k);
+			inflight += k;
+		}
+	}
+
+	secs = (mend - mstart) / 1e9;
+	bench_report(name, hp, "qd", (double)qd, "bs_kb", bs / 1024.0,
+	    "iops", ops / secs, "mb_s", ops * bs / secs / (1024 * 1024),
+	    "getevents_per_op", (double)calls / reaped, NULL);
+
+out:
+	(void) io_destroy(ctx);
+	bench_hist_free(hp);
+	aio_pool_destroy(pool);
+	free(evs);
+	free(cbs);
+	free(start);
+	return (rc);
+}
+
+static void
+sweep(int argc, char **argv, const char *mode, int oflags)
+{
+	char name[80], pfx[32];
+	struct bsize *bp;
+	int fd = -1, qd, unsup;
+
+	(void) snprintf(pfx, sizeof (pfx), "aio.qd.%s", mode);
+	for (bp = bsizes; bp->bs_name != NULL; bp++) {
+		unsup = 0;
+		for (qd = 1; qd <= MAX_QD; qd *= 2) {
+			if (qd * bp->bs_size > MAX_INFLIGHT)
+				break;
+			(void) snprintf(name, sizeof (name), "%s.%s.%d", pfx,
+			    bp->bs_name, qd);
+			if (!bench_selected(argc, argv, name))
+				continue;
+			if (unsup) {
+				bench_skip(name, "O_DIRECT reads of this size "
+				    "are not supported here");
+				continue;
+			}
+
+			/* The file is only made once something needs it */
+			if (fpath[0] == '\0')
+				make_file();
+			if (fd < 0)
+				fd = open(fpath, O_RDONLY | oflags);
+			if (fd < 0 && oflags & O_DIRECT && errno == EINVAL) {
+				bench_skip(pfx,
+				    "O_DIRECT is not supported here");
+				return;
+			}
+			if (fd < 0)
+				bench_fail(pfx, strerror(errno));
+			if (run_point(name, fd, qd, bp->bs_size, 0) != 0)
+				unsup = 1;
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+#define	CB_DATA(w, slot)	(((uint64_t)(w) << 32) | (uint32_t)(slot))
+#define	CB_WORKER(d)		((int)((d) >> 32))
+#define	CB_SLOT(d)		((int)((d) & 0xffffffff))
+
+/* Point an iocb at a new random block in its worker's region */
+static void
+mt_prep(worker_t *wp, struct iocb *cb)
+{
+	worker_t *op = &workers[CB_WORKER(cb->aio_data)];
+
+	cb->aio_lio_opcode = IOCB_CMD_PREAD;
+	cb->aio_fildes = op->w_fd;
+	cb->aio_offset = op->w_base +
+	    rand_blk(&wp->w_rng, op->w_len / MT_BS) * MT_BS;
+	op->w_start[CB_SLOT(cb->aio_data)] = bench_now();
+}
+
+static void
+mt_submit(worker_t *wp, struct iocb **cbs, int n)
+{
+	int rc;
+
+	(void) __sync_fetch_and_add(wp->w_inflight, n);
+	while (n > 0) {
+		if ((rc = io_submit(*wp->w_ctx, n, cbs)) < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			bench_fail(wp->w_name, strerror(errno));
+		}
+		cbs += rc;
+		n -= rc;
+	}
+}
+
+static void *
+mt_worker(void *arg)
+{
+	worker_t *wp = arg;
+	struct iocb *cbs[MT_QD];
+	struct io_event evs[MT_QD];
+	struct timespec ts = { 0, MT_POLL_NS };
+	uint64_t now;
+	int i, n, k;
+
+	if (bench_pin(wp->w_num % ncpus) != 0)
+		bench_fail(wp->w_name, "can't bind to a CPU");
+
+	for (i = 0; i < MT_QD; i++) {
+		cbs[i] = aio_pool_get(wp->w_pool);
+		cbs[i]->aio_data = CB_DATA(wp->w_num,
+		    aio_pool_slot(wp->w_pool, cbs[i]));
+		mt_prep(wp, cbs[i]);
+	}
+
+	(void) pthread_barrier_wait(wp->w_barrier);
+	mt_submit(wp, cbs, MT_QD);
+
+	/*
+	 * Stop resubmitting at the end of the run, and keep reaping until
+	 * nothing is in flight. In the shared variant the last events may be
+	 * reaped by another worker, hence the timeout.
+	 */
+	while (*wp->w_inflight > 0) {
+		n = io_getevents(*wp->w_ctx, 1, MT_QD, evs, &ts);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			bench_fail(wp->w_name, strerror(errno));
+		}
+		if (n == 0)
+			continue;
+		now = bench_now();
+		(void) __sync_fetch_and_sub(wp->w_inflight, n);
+
+		for (i = k = 0; i < n; i++) {
+			struct iocb *cb = (struct iocb *)(uintptr_t)evs[i].obj;
+			worker_t *op = &workers[CB_WORKER(cb->aio_data)];
+
+			if (evs[i].res != MT_BS)
+				bench_fail(wp->w_name, res_err(evs[i].res,
+				    "short read"));
+			if (now >= wp->w_mstart && now < wp->w_mend) {
+				bench_hist_record(wp->w_hist,
+				    now - op->w_start[CB_SLOT(cb->aio_data)]);
+				wp->w_ops++;
+			}
+			if (now < wp->w_mend) {
+				mt_prep(wp, cb);
+				cbs[k++] = cb;
+			}
+		}
+		if (k > 0)
+			mt_submit(wp, cbs, k);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Run 'nthr' workers, each pinned to its own CPU and keeping MT_QD reads in
+ * flight in its own part of the file, either each with its own context or all
+ * sharing one.
+ */
+static void
+run_mt(const char *name, int fd, int nthr, int shared)
+{
+	pthread_barrier_t barrier;
+	aio_context_t sctx = 0;
+	volatile int sinflight = 0;
+	bench_hist_t *hp;
+	uint64_t mstart, mend, ops = 0;
+	double secs;
+	int i;
+
+	if ((workers = calloc(nthr, sizeof (worker_t))) == NULL ||
+	    (hp = bench_hist_alloc()) == NULL)
+		bench_fail(name, "out of memory");
+	if (shared && io_setup(nthr * MT_QD, &sctx) < 0)
+		bench_fail(name, strerror(errno));
+	(void) pthread_barrier_init(&barrier, NULL, nthr);
+
+	/* Leave time for the workers to start before the measuring does */
+	mstart = bench_now() + bench_warmup() + MT_POLL_NS;
+	mend = mstart + bench_runtime();
+
+	for (i = 0; i < nthr; i++) {
+		worker_t *wp = &workers[i];
+
+		wp->w_num = i;
+		wp->w_fd = fd;
+		wp->w_len = fsize / nthr / MT_BS * MT_BS;
+		wp->w_base = i * wp->w_len;
+		wp->w_rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+		wp->w_mstart = mstart;
+		wp->w_mend = mend;
+		wp->w_barrier = &barrier;
+		wp->w_name = name;
+		wp->w_pool = aio_pool_create(MT_QD, MT_BS, AIO_POOL_HUGE);
+		wp->w_start = calloc(MT_QD, sizeof (uint64_t));
+		wp->w_hist = bench_hist_alloc();
+		if (wp->w_pool == NULL || wp->w_start == NULL ||
+		    wp->w_hist == NULL)
+			bench_fail(name, "out of memory");
+		if (shared) {
+			wp->w_ctx = &sctx;
+			wp->w_inflight = &sinflight;
+		} else {
+			wp->w_ctx = malloc(sizeof (aio_context_t));
+			if (wp->w_ctx == NULL)
+				bench_fail(name, "out of memory");
+			*wp->w_ctx = 0;
+			if (io_setup(MT_QD, wp->w_ctx) < 0)
+				bench_fail(name, strerror(errno));
+			wp->w_inflight = &wp->w_own_inflight;
+		}
+	}
+	for (i = 0; i < nthr; i++) {
+		if (pthread_create(&workers[i].w_tid, NULL, mt_worker,
+		    &workers[i]) != 0)
+			bench_fail(name, "pthread_create failed");
+	}
+	for (i = 0; i < nthr; i++) {
+		worker_t *wp = &workers[i];
+
+		(void) pthread_join(wp->w_tid, NULL);
+		bench_hist_merge(hp, wp->w_hist);
+		ops += wp->w_ops;
+	}
+
+	secs = (mend - mstart) / 1e9;
+	bench_report(name, hp, "threads", (double)nthr,
+	    "qd", (double)nthr * MT_QD, "iops", ops / secs,
+	    "iops_thread", ops / secs / nthr, NULL);
+
+	for (i = 0; i < nthr; i++) {
+		worker_t *wp = &workers[i];
+
+		if (!shared) {
+			(void) io_destroy(*wp->w_ctx);
+			free(wp->w_ctx);
+		}
+		aio_pool_destroy(wp->w_pool);
+		bench_hist_free(wp->w_hist);
+		free(wp->w_start);
+	}
+	if (shared)
+		(void) io_destroy(sctx);
+	(void) pthread_barrier_destroy(&barrier);
+	bench_hist_free(hp);
+	free(workers);
+	workers = NULL;
+}
+
+/* The next thread count after 'n': the powers of two, and then 'max' */
+static int
+next_nthr(int n, int max)
+{
+	if (n == max)
+		return (max + 1);
+	return (n * 2 < max ? n * 2 : max);
+}
+
+/*
+ * The thread counts run go up to the number of CPUs, or to
+ * LXTST_BENCH_AIO_THREADS if that's set. Workers beyond the number of CPUs
+ * share them.
+ */
+static void
+sweep_mt(int argc, char **argv)
+{
+	static const char *modes[] = { "private", "shared" };
+	char name[80], *s;
+	int fd = -1, m, nthr, maxthr;
+
+	if ((ncpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		ncpus = 1;
+	if ((s = getenv("LXTST_BENCH_AIO_THREADS")) != NULL && atoi(s) > 0)
+		maxthr = atoi(s);
+	else
+		maxthr = ncpus;
+
+	for (m = 0; m < 2; m++) {
+		for (nthr = 1; nthr <= maxthr; nthr = next_nthr(nthr, maxthr)) {
+			(void) snprintf(name, sizeof (name), "aio.mt.%s.%d",
+			    modes[m], nthr);
+			if (!bench_selected(argc, argv, name))
+				continue;
+
+			if (fpath[0] == '\0')
+				make_file();
+			if (fd < 0 && (fd = open(fpath, O_RDONLY)) < 0)
+				bench_fail(name, strerror(errno));
+			if (fsize / nthr < MT_BS) {
+				bench_skip(name, "the data file is too small");
+				continue;
+			}
+			run_mt(name, fd, nthr, m == 1);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/*
+ * State shared by the reapers of aio.reap.<N>. Only one read is outstanding
+ * at a time, so only the reaper which gets its event touches r_hist.
+ */
+static struct reap {
+	aio_context_t	r_ctx;
+	int		r_efd;		/* reapers post to this as they reap */
+	volatile uint64_t r_stamp;	/* when the read was submitted */
+	uint64_t	r_mstart;
+	uint64_t	r_mend;
+	bench_hist_t	*r_hist;
+	const char	*r_name;
+} reap;
+
+typedef struct reaper {
+	pthread_t	rp_tid;
+	uint64_t	rp_events;
+	long		rp_csw;		/* voluntary context switches */
+} reaper_t;
+
+static void *
+reaper(void *arg)
+{
+	reaper_t *rp = arg;
+	struct io_event ev;
+	struct rusage ru0, ru1;
+	uint64_t now, one = 1;
+	int n, ru;
+
+	ru = getrusage(RUSAGE_THREAD, &ru0);
+	for (;;) {
+		if ((n = io_getevents(reap.r_ctx, 1, 1, &ev, NULL)) < 0) {
+			if (errno == EINTR)
+				continue;
+			bench_fail(reap.r_name, strerror(errno));
+		}
+		if (n == 0)
+			continue;
+		now = bench_now();
+		if (ev.data == REAP_STOP)
+			break;
+		if (ev.res != MT_BS)
+			bench_fail(reap.r_name, res_err(ev.res, "short read"));
+
+		rp->rp_events++;
+		if (now >= reap.r_mstart && now < reap.r_mend)
+			bench_hist_record(reap.r_hist, now - reap.r_stamp);
+		if (write(reap.r_efd, &one, sizeof (one)) != sizeof (one))
+			bench_fail(reap.r_name, strerror(errno));
+	}
+
+	/* Every sleep in io_getevents() is a voluntary context switch */
+	if (ru == 0 && getrusage(RUSAGE_THREAD, &ru1) == 0)
+		rp->rp_csw = ru1.ru_nvcsw - ru0.ru_nvcsw;
+	else
+		rp->rp_csw = -1;
+	return (NULL);
+}
+
+/*
+ * Block 'nthr' threads in io_getevents() on one context, and submit reads to
+ * it one at a time, waiting for each to be reaped before submitting the next.
+ * The reads are of cached data, so they complete in io_submit(); the time
+ * recorded is from just before then until a reaper returns with the event.
+ * Besides the latency, this reports how evenly the events were spread over
+ * the reapers (Jain's index, 1 being perfectly even, and the least and most
+ * events any reaper got as a fraction of an even share), and how many times
+ * the reapers went to sleep for each event, where anything over one is a
+ * reaper woken for an event which another reaper took.
+ */
+static void
+run_reap(const char *name, int fd, int nthr)
+{
+	reaper_t *rps;
+	aio_pool_t *pool;
+	struct iocb *cb, *stop[REAP_MAX];
+	uint64_t v, rng_reap = 0x9e3779b97f4a7c15ULL, events = 0;
+	double sum = 0, sumsq = 0, min = -1, max = 0;
+	long csw = 0;
+	int i, rc;
+
+	reap.r_name = name;
+	reap.r_ctx = 0;
+	if ((rps = calloc(nthr, sizeof (reaper_t))) == NULL ||
+	    (reap.r_hist = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(nthr + 1, MT_BS, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	if (io_setup(nthr + 1, &reap.r_ctx) < 0)
+		bench_fail(name, strerror(errno));
+	if ((reap.r_efd = eventfd(0, 0)) < 0)
+		bench_fail(name, strerror(errno));
+
+	for (i = 0; i < nthr; i++) {
+		if (pthread_create(&rps[i].rp_tid, NULL, reaper, &rps[i]) != 0)
+			bench_fail(name, "pthread_create failed");
+	}
+
+	cb = aio_pool_get(pool);
+	cb->aio_lio_opcode = IOCB_CMD_PREAD;
+	cb->aio_fildes = fd;
+	reap.r_mstart = bench_now() + bench_warmup();
+	reap.r_mend = reap.r_mstart + bench_runtime();
+
+	while (bench_now() < reap.r_mend) {
+		cb->aio_offset = rand_blk(&rng_reap, fsize / MT_BS) * MT_BS;
+		reap.r_stamp = bench_now();
+		if ((rc = io_submit(reap.r_ctx, 1, &cb)) != 1) {
+			if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			bench_fail(name, strerror(errno));
+		}
+		while (read(reap.r_efd, &v, sizeof (v)) != sizeof (v)) {
+			if (errno != EINTR)
+				bench_fail(name, strerror(errno));
+		}
+	}
+
+	/* One stop event for each reaper; none will take two */
+	for (i = 0; i < nthr; i++) {
+		stop[i] = aio_pool_get(pool);
+		stop[i]->aio_lio_opcode = IOCB_CMD_PREAD;
+		stop[i]->aio_fildes = fd;
+		stop[i]->aio_data = REAP_STOP;
+	}
+	if (io_submit(reap.r_ctx, nthr, stop) != nthr)
+		bench_fail(name, strerror(errno));
+
+	for (i = 0; i < nthr; i++) {
+		double x;
+
+		(void) pthread_join(rps[i].rp_tid, NULL);
+		x = rps[i].rp_events;
+		events += rps[i].rp_events;
+		sum += x;
+		sumsq += x * x;
+		if (min < 0 || x < min)
+			min = x;
+		if (x > max)
+			max = x;
+		if (csw >= 0)
+			csw = rps[i].rp_csw < 0 ? -1 : csw + rps[i].rp_csw;
+	}
+	if (events == 0)
+		bench_fail(name, "no events were reaped");
+
+	if (csw >= 0) {
+		/* The stop events may have cost a sleep each as well */
+		csw = csw > nthr ? csw - nthr : 0;
+		bench_report(name, reap.r_hist, "threads", (double)nthr,
+		    "fairness", sum * sum / (nthr * sumsq),
+		    "min_share", min * nthr / sum,
+		    "max_share", max * nthr / sum,
+		    "sleeps_per_event", (double)csw / events, NULL);
+	} else {
+		bench_report(name, reap.r_hist, "threads", (double)nthr,
+		    "fairness", sum * sum / (nthr * sumsq),
+		    "min_share", min * nthr / sum,
+		    "max_share", max * nthr / sum,
+		    NULL);
+	}
+
+	(void) io_destroy(reap.r_ctx);
+	(void) close(reap.r_efd);
+	aio_pool_destroy(pool);
+	bench_hist_free(reap.r_hist);
+	free(rps);
+}
+
+static void
+sweep_reap(int argc, char **argv)
+{
+	char name[80];
+	int fd = -1, nthr;
+
+	for (nthr = 1; nthr <= REAP_MAX; nthr *= 2) {
+		(void) snprintf(name, sizeof (name), "aio.reap.%d", nthr);
+		if (!bench_selected(argc, argv, name))
+			continue;
+
+		if (fpath[0] == '\0')
+			make_file();
+		if (fd < 0 && (fd = open(fpath, O_RDONLY)) < 0)
+			bench_fail(name, strerror(errno));
+		run_reap(name, fd, nthr);
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/* CPU time used by the process, in nanoseconds */
+static uint64_t
+cpu_ns()
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return (0);
+	return ((ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+	    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL);
+}
+
+/*
+ * An event loop of the kind production servers use: 'inflight' reads spread
+ * over 'nctx' contexts, all of them signalling completion with
+ * IOCB_FLAG_RESFD on one eventfd, which an epoll loop waits on. Each time the
+ * eventfd fires, the loop reads it, reaps the completions it counted from the
+ * contexts without blocking, and resubmits them. Besides the latency from
+ * submission to reaping, this reports completions per second, how many
+ * completions each eventfd read covered, and the CPU time the loop used per
+ * completion.
+ */
+static void
+run_efd(const char *name, int fd, int nctx, int inflight)
+{
+	aio_context_t *ctxs;
+	aio_pool_t *pool;
+	struct iocb **cbs;
+	struct io_event *evs;
+	struct epoll_event ev;
+	struct timespec zero = { 0, 0 };
+	bench_hist_t *hp;
+	uint64_t *start, cnt, now, mstart, mend, cpu0 = 0, cpu1 = 0;
+	uint64_t ops = 0, reads = 0;
+	int efd, epfd, i, c, n, k, got, idle, left, rc;
+	double secs;
+
+	ctxs = calloc(nctx, sizeof (aio_context_t));
+	cbs = calloc(inflight, sizeof (struct iocb *));
+	evs = calloc(inflight, sizeof (struct io_event));
+	start = calloc(inflight, sizeof (uint64_t));
+	if (ctxs == NULL || cbs == NULL || evs == NULL || start == NULL ||
+	    (hp = bench_hist_alloc()) == NULL)
+		bench_fail(name, "out of memory");
+	if ((pool = aio_pool_create(inflight, MT_BS, AIO_POOL_HUGE)) == NULL)
+		bench_fail(name, strerror(errno));
+	if ((efd = eventfd(0, EFD_NONBLOCK)) < 0 ||
+	    (epfd = epoll_create1(0)) < 0)
+		bench_fail(name, strerror(errno));
+	ev.events = EPOLLIN;
+	ev.data.fd = efd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &ev) != 0)
+		bench_fail(name, strerror(errno));
+	for (c = 0; c < nctx; c++) {
+		if (io_setup(inflight / nctx, &ctxs[c]) < 0)
+			bench_fail(name, strerror(errno));
+	}
+
+	/* iocb 'i' always goes to context i % nctx */
+	for (i = 0; i < inflight; i++) {
+		cbs[i] = aio_pool_get(pool);
+		cbs[i]->aio_data = aio_pool_slot(pool, cbs[i]);
+		cbs[i]->aio_lio_opcode = IOCB_CMD_PREAD;
+		cbs[i]->aio_fildes = fd;
+		cbs[i]->aio_flags = IOCB_FLAG_RESFD;
+		cbs[i]->aio_resfd = efd;
+	}
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+
+	for (c = 0; c < nctx; c++) {
+		for (i = c, k = 0; i < inflight; i += nctx, k++) {
+			cbs[i]->aio_offset =
+			    rand_blk(&rng, fsize / MT_BS) * MT_BS;
+			start[i] = bench_now();
+			if ((rc = io_submit(ctxs[c], 1, &cbs[i])) != 1) {
+				if (rc < 0 && errno == EINVAL) {
+					bench_skip(name,
+					    "IOCB_FLAG_RESFD is not supported");
+					goto out;
+				}
+				bench_fail(name, strerror(errno));
+			}
+		}
+	}
+	left = inflight;
+
+	c = 0;
+	while (left > 0) {
+		if ((n = epoll_wait(epfd, &ev, 1, 100)) < 0) {
+			if (errno == EINTR)
+				continue;
+			bench_fail(name, strerror(errno));
+		}
+		if (n == 0)
+			continue;
+		if (read(efd, &cnt, sizeof (cnt)) != sizeof (cnt)) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			bench_fail(name, strerror(errno));
+		}
+
+		now = bench_now();
+		if (cpu0 == 0 && now >= mstart)
+			cpu0 = cpu_ns();
+		if (cpu1 == 0 && now >= mend)
+			cpu1 = cpu_ns();
+		if (now >= mstart && now < mend)
+			reads++;
+
+		/*
+		 * Reap the 'cnt' completions the eventfd counted, going round
+		 * the contexts and carrying on where the last pass left off.
+		 */
+		for (got = idle = 0; got < cnt && idle < nctx;
+		    c = (c + 1) % nctx) {
+			n = io_getevents(ctxs[c], 0, inflight / nctx, evs,
+			    &zero);
+			if (n < 0)
+				bench_fail(name, strerror(errno));
+			if (n == 0) {
+				idle++;
+				continue;
+			}
+			idle = 0;
+			got += n;
+			left -= n;
+			now = bench_now();
+
+			for (i = k = 0; i < n; i++) {
+				struct iocb *cb =
+				    (struct iocb *)(uintptr_t)evs[i].obj;
+
+				if (evs[i].res != MT_BS)
+					bench_fail(name, res_err(evs[i].res,
+					    "short read"));
+				if (now >= mstart && now < mend) {
+					bench_hist_record(hp,
+					    now - start[evs[i].data]);
+					ops++;
+				}
+				if (now < mend) {
+					cb->aio_offset = rand_blk(&rng,
+					    fsize / MT_BS) * MT_BS;
+					start[evs[i].data] = bench_now();
+					cbs[k++] = cb;
+				}
+			}
+			if (k > 0) {
+				if ((rc = io_submit(ctxs[c], k, cbs)) != k)
+					bench_fail(name, rc < 0 ?
+					    strerror(errno) : "partial submit");
+				left += k;
+			}
+		}
+	}
+	if (cpu1 == 0)
+		cpu1 = cpu_ns();
+
+	if (ops == 0 || reads == 0)
+		bench_fail(name, "nothing completed");
+	secs = (mend - mstart) / 1e9;
+	bench_report(name, hp, "ctxs", (double)nctx, "inflight",
+	    (double)inflight, "completions_s", ops / secs,
+	    "completions_per_read", (double)ops / reads,
+	    "cpu_ns_per_completion", (double)(cpu1 - cpu0) / ops, NULL);
+
+out:
+	for (c = 0; c < nctx; c++)
+		(void) io_destroy(ctxs[c]);
+	(void) close(epfd);
+	(void) close(efd);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+	free(start);
+	free(evs);
+	free(cbs);
+	free(ctxs);
+}
+
+static void
+sweep_efd(int argc, char **argv)
+{
+	static const int nctxs[] = { 1, 4, 16, 0 };
+	char name[80];
+	int fd = -1, i, inflight;
+
+	for (i = 0; nctxs[i] != 0; i++) {
+		for (inflight = 64; inflight <= EFD_MAX_INFLIGHT;
+		    inflight *= 4) {
+			(void) snprintf(name, sizeof (name), "aio.efd.%d.%d",
+			    nctxs[i], inflight);
+			if (!bench_selected(argc, argv, name))
+				continue;
+
+			if (fpath[0] == '\0')
+				make_file();
+			if (fd < 0 && (fd = open(fpath, O_RDONLY)) < 0)
+				bench_fail(name, strerror(errno));
+			run_efd(name, fd, nctxs[i], inflight);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/*
+ * Compare reaping with io_getevents() against reaping from the completion
+ * ring, falling back to io_getevents() only when it's empty, at a few queue
+ * depths of cached 4k reads.
+ */
+static void
+sweep_ring(int argc, char **argv)
+{
+	static const int qds[] = { 1, 32, 256, 0 };
+	static const char *modes[] = { "syscall", "ring" };
+	char name[80];
+	int fd = -1, i, m;
+
+	for (m = 0; m < 2; m++) {
+		for (i = 0; qds[i] != 0; i++) {
+			(void) snprintf(name, sizeof (name), "aio.ring.%s.%d",
+			    modes[m], qds[i]);
+			if (!bench_selected(argc, argv, name))
+				continue;
+
+			if (fpath[0] == '\0')
+				make_file();
+			if (fd < 0 && (fd = open(fpath, O_RDONLY)) < 0)
+				bench_fail(name, strerror(errno));
+			run_point(name, fd, qds[i], MT_BS, m == 1);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/*
+ * Submit batches of 'batch' cached reads, reaping each batch before the next,
+ * and time each io_submit(). The time per iocb of every call also goes into
+ * 'all', and the median time per call is returned for fitting.
+ */
+static double
+run_batch(const char *name, int fd, int batch, bench_hist_t *all)
+{
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	struct iocb *cbs[BATCH_MAX];
+	struct io_event evs[BATCH_MAX];
+	bench_hist_t *hp;
+	uint64_t t0, t1, mstart, mend;
+	double p50;
+	int i, n, rc;
+
+	if ((hp = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(batch, BATCH_BS, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	if (io_setup(batch, &ctx) < 0)
+		bench_fail(name, strerror(errno));
+
+	for (i = 0; i < batch; i++) {
+		cbs[i] = aio_pool_get(pool);
+		cbs[i]->aio_lio_opcode = IOCB_CMD_PREAD;
+		cbs[i]->aio_fildes = fd;
+	}
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		for (i = 0; i < batch; i++) {
+			cbs[i]->aio_offset = rand_blk(&rng,
+			    fsize / BATCH_BS) * BATCH_BS;
+		}
+
+		t0 = bench_now();
+		rc = io_submit(ctx, batch, cbs);
+		t1 = bench_now();
+		if (rc != batch)
+			bench_fail(name, rc < 0 ? strerror(errno) :
+			    "partial submit");
+		if (t0 >= mstart) {
+			bench_hist_record(hp, t1 - t0);
+			bench_hist_record(all, (t1 - t0) / batch);
+		}
+
+		for (n = 0; n < batch; n += rc) {
+			rc = io_getevents(ctx, batch - n, batch - n, evs, NULL);
+			if (rc < 0 && errno != EINTR)
+				bench_fail(name, strerror(errno));
+			if (rc < 0)
+				rc = 0;
+		}
+	} while (t1 < mend);
+
+	p50 = bench_hist_pct(hp, 50.0);
+	bench_report(name, hp, "batch", (double)batch,
+	    "ns_per_iocb", (double)bench_hist_mean(hp) / batch, NULL);
+
+	(void) io_destroy(ctx);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+	return (p50);
+}
+
+/*
+ * Run aio.batch.<n> for batches of 1 to BATCH_MAX iocbs, and then, if more
+ * than one was run, aio.batch.fit. Its histogram is of the time per iocb of
+ * every call at every batch size, and it splits the cost of a call into a
+ * fixed part and a part per iocb. These come from a least squares fit of the
+ * median time per iocb against 1 / batch size, i.e. time = fixed + per_iocb *
+ * batch weighted by relative rather than absolute error, so that the
+ * variation of the largest batches doesn't swamp the fixed cost.
+ */
+static void
+sweep_batch(int argc, char **argv)
+{
+	bench_hist_t *all;
+	char name[80];
+	double x, y, n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0, slope;
+	int fd = -1, batch;
+
+	if ((all = bench_hist_alloc()) == NULL)
+		bench_fail("aio.batch", "out of memory");
+
+	for (batch = 1; batch <= BATCH_MAX; batch *= 2) {
+		(void) snprintf(name, sizeof (name), "aio.batch.%d", batch);
+		if (!bench_selected(argc, argv, name))
+			continue;
+
+		if (fpath[0] == '\0')
+			make_file();
+		if (fd < 0 && (fd = open(fpath, O_RDONLY)) < 0)
+			bench_fail(name, strerror(errno));
+
+		x = 1.0 / batch;
+		y = run_batch(name, fd, batch, all) / batch;
+		n++;
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+
+	if (n > 1 && bench_selected(argc, argv, "aio.batch.fit")) {
+		slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+		bench_report("aio.batch.fit", all, "fixed_ns", slope,
+		    "per_iocb_ns", (sy - slope * sx) / n, NULL);
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+	bench_hist_free(all);
+}
+
+/*
+ * Write 'nseg' VEC_SEG buffers to consecutive parts of the file, either as
+ * one IOCB_CMD_PWRITEV iocb or as 'nseg' IOCB_CMD_PWRITE iocbs submitted
+ * together, and time each write from submission until all of it has been
+ * reaped. The writes go through the page cache and work their way through the
+ * file, wrapping round at the end.
+ */
+static void
+run_vec(const char *name, int fd, int nseg, int vec)
+{
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	struct iocb *segs[VEC_MAX], *vcb;
+	struct iovec iov[VEC_MAX];
+	struct io_event evs[VEC_MAX];
+	bench_hist_t *hp;
+	uint64_t t0, t1, mstart, mend, ops = 0;
+	off_t off = 0, unit = (off_t)nseg * VEC_SEG;
+	int i, n, rc, niocb = vec ? 1 : nseg;
+	double secs;
+
+	if ((hp = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(nseg + 1, VEC_SEG, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	if (io_setup(nseg, &ctx) < 0)
+		bench_fail(name, strerror(errno));
+
+	for (i = 0; i < nseg; i++) {
+		segs[i] = aio_pool_get(pool);
+		segs[i]->aio_lio_opcode = IOCB_CMD_PWRITE;
+		segs[i]->aio_fildes = fd;
+		iov[i].iov_base = (void *)(uintptr_t)segs[i]->aio_buf;
+		iov[i].iov_len = VEC_SEG;
+		pattern_fill(iov[i].iov_base, VEC_SEG, i);
+	}
+	vcb = aio_pool_get(pool);
+	vcb->aio_lio_opcode = IOCB_CMD_PWRITEV;
+	vcb->aio_fildes = fd;
+	vcb->aio_buf = (uint64_t)(uintptr_t)iov;
+	vcb->aio_nbytes = nseg;
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		if (off + unit > fsize)
+			off = 0;
+		vcb->aio_offset = off;
+		for (i = 0; i < nseg; i++)
+			segs[i]->aio_offset = off + i * VEC_SEG;
+		off += unit;
+
+		t0 = bench_now();
+		if ((rc = io_submit(ctx, niocb, vec ? &vcb : segs)) != niocb) {
+			if (rc < 0 && errno == EINVAL && vec) {
+				bench_skip(name,
+				    "IOCB_CMD_PWRITEV is not supported");
+				goto out;
+			}
+			bench_fail(name, rc < 0 ? strerror(errno) :
+			    "partial submit");
+		}
+		for (n = 0; n < niocb; n += rc) {
+			rc = io_getevents(ctx, niocb - n, niocb - n, evs, NULL);
+			if (rc < 0 && errno != EINTR)
+				bench_fail(name, strerror(errno));
+			if (rc < 0)
+				rc = 0;
+			for (i = 0; i < rc; i++) {
+				if (evs[i].res != (vec ? unit : VEC_SEG))
+					bench_fail(name, res_err(evs[i].res,
+					    "short write"));
+			}
+		}
+		t1 = bench_now();
+		if (t0 >= mstart && t1 < mend) {
+			bench_hist_record(hp, t1 - t0);
+			ops++;
+		}
+	} while (t1 < mend);
+
+	secs = (mend - mstart) / 1e9;
+	bench_report(name, hp, "segs", (double)nseg, "iocbs", (double)niocb,
+	    "mb_s", ops * unit / secs / (1024 * 1024), NULL);
+
+out:
+	(void) io_destroy(ctx);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+}
+
+static void
+sweep_vec(int argc, char **argv)
+{
+	static const char *modes[] = { "pwrite", "pwritev" };
+	char name[80];
+	int fd = -1, m, nseg;
+
+	for (m = 0; m < 2; m++) {
+		for (nseg = 1; nseg <= VEC_MAX; nseg *= 4) {
+			(void) snprintf(name, sizeof (name), "aio.vec.%s.%d",
+			    modes[m], nseg);
+			if (!bench_selected(argc, argv, name))
+				continue;
+
+			if (fpath[0] == '\0')
+				make_file();
+			if (fd < 0 && (fd = open(fpath, O_WRONLY)) < 0)
+				bench_fail(name, strerror(errno));
+			if ((off_t)nseg * VEC_SEG > fsize) {
+				bench_skip(name, "the data file is too small");
+				continue;
+			}
+			run_vec(name, fd, nseg, m == 1);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/* Make 'cb' a poll for input on 'fd', which won't complete until it's ready */
+static void
+prep_poll(struct iocb *cb, int fd)
+{
+	cb->aio_lio_opcode = IOCB_CMD_POLL;
+	cb->aio_fildes = fd;
+	cb->aio_buf = POLLIN;
+	cb->aio_nbytes = 0;
+	cb->aio_offset = 0;
+}
+
+/* Submit all of 'n' iocbs; returns -1 with errno set on failure */
+static int
+submit_all(aio_context_t ctx, struct iocb **cbs, int n)
+{
+	int i, rc;
+
+	for (i = 0; i < n; i += rc) {
+		if ((rc = io_submit(ctx, n - i, cbs + i)) < 0) {
+			if (errno != EINTR)
+				return (-1);
+			rc = 0;
+		}
+	}
+	return (0);
+}
+
+/*
+ * Time io_cancel() of each of 'n' polls on an eventfd which never becomes
+ * ready, in a random order, since Linux finds the iocb to cancel by walking
+ * the context's list of those in flight. Polls are what Linux can cancel;
+ * reads and writes are not.
+ */
+static void
+run_cancel(const char *name, int n)
+{
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	struct iocb **cbs, *tmp;
+	struct io_event ev, *evs;
+	bench_hist_t *hp;
+	uint64_t t0, t1, mstart, mend;
+	int efd, i, j, rc, got, posted;
+
+	cbs = calloc(n, sizeof (struct iocb *));
+	evs = calloc(n, sizeof (struct io_event));
+	if (cbs == NULL || evs == NULL || (hp = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(n, 0, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	if (io_setup(n, &ctx) < 0 || (efd = eventfd(0, 0)) < 0)
+		bench_fail(name, strerror(errno));
+	for (i = 0; i < n; i++) {
+		cbs[i] = aio_pool_get(pool);
+		prep_poll(cbs[i], efd);
+	}
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		if (submit_all(ctx, cbs, n) != 0) {
+			if (errno == EINVAL) {
+				bench_skip(name,
+				    "IOCB_CMD_POLL is not supported");
+				goto out;
+			}
+			bench_fail(name, strerror(errno));
+		}
+		for (i = n - 1; i > 0; i--) {
+			j = rand_blk(&rng, i + 1);
+			tmp = cbs[i];
+			cbs[i] = cbs[j];
+			cbs[j] = tmp;
+		}
+
+		for (i = posted = 0; i < n; i++) {
+			t0 = bench_now();
+			rc = io_cancel(ctx, cbs[i], &ev);
+			t1 = bench_now();
+			/*
+			 * Older kernels return the event; newer ones post it
+			 * to the ring once the cancellation is done.
+			 */
+			if (rc != 0 && errno != EINPROGRESS)
+				bench_fail(name, strerror(errno));
+			if (rc != 0)
+				posted++;
+			if (t0 >= mstart)
+				bench_hist_record(hp, t1 - t0);
+		}
+
+		for (got = 0; got < posted; got += rc) {
+			struct timespec ts = { 1, 0 };
+
+			rc = io_getevents(ctx, posted - got, posted - got, evs,
+			    &ts);
+			if (rc < 0 && errno != EINTR)
+				bench_fail(name, strerror(errno));
+			if (rc == 0)
+				bench_fail(name,
+				    "cancelled polls didn't complete");
+			if (rc < 0)
+				rc = 0;
+		}
+	} while (t1 < mend);
+
+	bench_report(name, hp, "inflight", (double)n, NULL);
+
+out:
+	(void) io_destroy(ctx);
+	(void) close(efd);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+	free(evs);
+	free(cbs);
+}
+
+/*
+ * Time io_destroy() of a context with 'n' iocbs in flight: either polls,
+ * which it cancels, or O_DIRECT reads, which it must wait for. This carries
+ * on past the end of the run time until there are KILL_MIN_RUNS samples.
+ */
+static void
+run_destroy(const char *name, int fd, int n, int poll)
+{
+	aio_context_t ctx;
+	aio_pool_t *pool;
+	struct iocb **cbs;
+	bench_hist_t *hp;
+	uint64_t t0, t1, mstart, mend;
+	int efd, i;
+
+	if ((cbs = calloc(n, sizeof (struct iocb *))) == NULL ||
+	    (hp = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(n, MT_BS, AIO_POOL_HUGE)) == NULL)
+		bench_fail(name, "out of memory");
+	if ((efd = eventfd(0, 0)) < 0)
+		bench_fail(name, strerror(errno));
+	for (i = 0; i < n; i++) {
+		cbs[i] = aio_pool_get(pool);
+		if (poll)
+			prep_poll(cbs[i], efd);
+		else
+			prep(cbs[i], fd, MT_BS);
+	}
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		ctx = 0;
+		if (io_setup(n, &ctx) < 0)
+			bench_fail(name, strerror(errno));
+		if (!poll) {
+			for (i = 0; i < n; i++)
+				prep(cbs[i], fd, MT_BS);
+		}
+		if (submit_all(ctx, cbs, n) != 0) {
+			if (poll && errno == EINVAL) {
+				(void) io_destroy(ctx);
+				bench_skip(name,
+				    "IOCB_CMD_POLL is not supported");
+				goto out;
+			}
+			bench_fail(name, strerror(errno));
+		}
+
+		t0 = bench_now();
+		if (io_destroy(ctx) != 0)
+			bench_fail(name, strerror(errno));
+		t1 = bench_now();
+		if (t0 >= mstart)
+			bench_hist_record(hp, t1 - t0);
+	} while (t1 < mend || hp->bh_count < KILL_MIN_RUNS);
+
+	bench_report(name, hp, "inflight", (double)n, NULL);
+
+out:
+	(void) close(efd);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+	free(cbs);
+}
+
+static void
+sweep_kill(int argc, char **argv)
+{
+	char name[80];
+	int fd = -1, n;
+
+	for (n = 16; n <= KILL_MAX; n *= 16) {
+		(void) snprintf(name, sizeof (name), "aio.cancel.poll.%d", n);
+		if (bench_selected(argc, argv, name))
+			run_cancel(name, n);
+	}
+	for (n = 16; n <= KILL_MAX; n *= 16) {
+		(void) snprintf(name, sizeof (name), "aio.destroy.poll.%d", n);
+		if (bench_selected(argc, argv, name))
+			run_destroy(name, -1, n, 1);
+	}
+	for (n = 16; n <= KILL_MAX; n *= 16) {
+		(void) snprintf(name, sizeof (name), "aio.destroy.direct.%d",
+		    n);
+		if (!bench_selected(argc, argv, name))
+			continue;
+
+		if (fpath[0] == '\0')
+			make_file();
+		if (fd < 0)
+			fd = open(fpath, O_RDONLY | O_DIRECT);
+		if (fd < 0 && errno == EINVAL) {
+			bench_skip(name, "O_DIRECT is not supported here");
+			break;
+		}
+		if (fd < 0)
+			bench_fail(name, strerror(errno));
+		run_destroy(name, fd, n, 0);
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/*
+ * Compare getting readiness of 'nconn' TCP loopback connections through
+ * IOCB_CMD_POLL with getting it from epoll_wait(). Each round writes a byte
+ * to the client end of every connection and then waits for every server end
+ * to become readable and reads the byte. With aio, a poll is kept pending on
+ * each server end and, being one-shot, resubmitted after the read; with
+ * epoll, the server ends stay registered, level-triggered. The time recorded
+ * is that of a whole round.
+ */
+static void
+run_ready(const char *name, int nconn, int aio)
+{
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	struct iocb **cbs;
+	struct io_event *evs;
+	struct epoll_event *eevs, ev;
+	bench_hist_t *hp;
+	uint64_t t0, t1, mstart, mend, rounds = 0;
+	int (*fds)[2], lfd, port, epfd = -1, i, n, got;
+	char c = 'x';
+	double secs;
+
+	fds = calloc(nconn, sizeof (*fds));
+	cbs = calloc(nconn, sizeof (struct iocb *));
+	evs = calloc(nconn, sizeof (struct io_event));
+	eevs = calloc(nconn, sizeof (struct epoll_event));
+	if (fds == NULL || cbs == NULL || evs == NULL || eevs == NULL ||
+	    (hp = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(nconn, 0, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	if ((lfd = loopback_listen(&port)) < 0)
+		bench_fail(name, strerror(errno));
+	for (i = 0; i < nconn; i++) {
+		if (loopback_pair(lfd, fds[i]) != 0)
+			bench_fail(name, strerror(errno));
+	}
+
+	if (aio) {
+		if (io_setup(nconn, &ctx) < 0)
+			bench_fail(name, strerror(errno));
+		for (i = 0; i < nconn; i++) {
+			cbs[i] = aio_pool_get(pool);
+			prep_poll(cbs[i], fds[i][1]);
+			cbs[i]->aio_data = i;
+		}
+		if (submit_all(ctx, cbs, nconn) != 0) {
+			if (errno == EINVAL) {
+				bench_skip(name,
+				    "IOCB_CMD_POLL is not supported");
+				goto out;
+			}
+			bench_fail(name, strerror(errno));
+		}
+	} else {
+		if ((epfd = epoll_create1(0)) < 0)
+			bench_fail(name, strerror(errno));
+		for (i = 0; i < nconn; i++) {
+			ev.events = EPOLLIN;
+			ev.data.u32 = i;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i][1], &ev) != 0)
+				bench_fail(name, strerror(errno));
+		}
+	}
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		t0 = bench_now();
+		for (i = 0; i < nconn; i++) {
+			if (write(fds[i][0], &c, 1) != 1)
+				bench_fail(name, strerror(errno));
+		}
+
+		for (got = 0; got < nconn; got += n) {
+			if (aio)
+				n = io_getevents(ctx, 1, nconn - got, evs,
+				    NULL);
+			else
+				n = epoll_wait(epfd, eevs, nconn, -1);
+			if (n < 0 && errno != EINTR)
+				bench_fail(name, strerror(errno));
+			for (i = 0; i < n; i++) {
+				int conn = aio ? evs[i].data : eevs[i].data.u32;
+
+				if (read(fds[conn][1], &c, 1) != 1)
+					bench_fail(name, strerror(errno));
+				if (aio)
+					cbs[i] = (struct iocb *)(uintptr_t)
+					    evs[i].obj;
+			}
+			if (aio && n > 0 && submit_all(ctx, cbs, n) != 0)
+				bench_fail(name, strerror(errno));
+			if (n < 0)
+				n = 0;
+		}
+		t1 = bench_now();
+
+		if (t0 >= mstart && t1 < mend) {
+			bench_hist_record(hp, t1 - t0);
+			rounds++;
+		}
+	} while (t1 < mend);
+
+	secs = (mend - mstart) / 1e9;
+	bench_report(name, hp, "conns", (double)nconn,
+	    "notifications_s", rounds * nconn / secs, NULL);
+
+out:
+	if (aio)
+		(void) io_destroy(ctx);
+	else
+		(void) close(epfd);
+	for (i = 0; i < nconn; i++) {
+		(void) close(fds[i][0]);
+		(void) close(fds[i][1]);
+	}
+	(void) close(lfd);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+	free(eevs);
+	free(evs);
+	free(cbs);
+	free(fds);
+}
+
+static void
+sweep_ready(int argc, char **argv)
+{
+	static const char *modes[] = { "epoll", "aio" };
+	char name[80];
+	int m, nconn;
+
+	for (m = 0; m < 2; m++) {
+		for (nconn = 1; nconn <= READY_MAX; nconn *= 16) {
+			(void) snprintf(name, sizeof (name), "aio.ready.%s.%d",
+			    modes[m], nconn);
+			if (bench_selected(argc, argv, name))
+				run_ready(name, nconn, m == 1);
+		}
+	}
+}
+
+/*
+ * Do RWF_BS reads or writes at random offsets one at a time, with the flag
+ * from 'rf' in aio_rw_flags, timing both the io_submit() and the whole I/O
+ * from just before the submit until io_getevents() returns it. Appending
+ * writes grow the file, which is cut back to its size now and then, outside
+ * the timed part. The cold points drop the file from the page cache before
+ * each read, also outside the timed part, so that buffered reads go to the
+ * disk and RWF_NOWAIT reads miss. It's the whole file since Linux only drops
+ * a cached folio, which may be far bigger than a block, if all of it's in
+ * the range. An I/O completing with EAGAIN, as
+ * those misses do, is timed like any other, and counts towards 'eagain_pct'.
+ */
+static void
+run_rwflag(const char *name, int fd, struct rwflag *rf)
+{
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	struct iocb *cb;
+	struct io_event ev;
+	bench_hist_t *hp, *sub;
+	uint64_t t0, t1, t2, mstart, mend, ops = 0, eagain = 0;
+	off_t grown = 0;
+	int rc;
+
+	if ((hp = bench_hist_alloc()) == NULL ||
+	    (sub = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(1, RWF_BS, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	if (io_setup(1, &ctx) < 0)
+		bench_fail(name, strerror(errno));
+
+	cb = aio_pool_get(pool);
+	cb->aio_lio_opcode = rf->rf_op;
+	cb->aio_fildes = fd;
+	cb->aio_rw_flags = rf->rf_flags;
+	pattern_fill((void *)(uintptr_t)cb->aio_buf, RWF_BS, 0);
+
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		if (grown > RWF_GROW_MAX) {
+			if (ftruncate(fd, fsize) != 0)
+				bench_fail(name, strerror(errno));
+			grown = 0;
+		}
+		cb->aio_offset = rand_blk(&rng, fsize / RWF_BS) * RWF_BS;
+		if (rf->rf_cold && (rc = posix_fadvise(fd, 0, 0,
+		    POSIX_FADV_DONTNEED)) != 0)
+			bench_fail(name, strerror(rc));
+
+		t0 = bench_now();
+		if ((rc = io_submit(ctx, 1, &cb)) != 1) {
+			if (rc < 0 &&
+			    (errno == EOPNOTSUPP || errno == EINVAL)) {
+				bench_skip(name, "the flag is not supported");
+				goto out;
+			}
+			bench_fail(name, rc < 0 ? strerror(errno) :
+			    "partial submit");
+		}
+		t1 = bench_now();
+		while ((rc = io_getevents(ctx, 1, 1, &ev, NULL)) != 1) {
+			if (rc < 0 && errno != EINTR)
+				bench_fail(name, strerror(errno));
+		}
+		t2 = bench_now();
+
+		if (ev.res == -EOPNOTSUPP) {
+			bench_skip(name, "the flag is not supported here");
+			goto out;
+		}
+		if (ev.res != RWF_BS && ev.res != -EAGAIN)
+			bench_fail(name, ev.res < 0 ? strerror(-ev.res) :
+			    "short I/O");
+		if (rf->rf_flags & RWF_APPEND)
+			grown += RWF_BS;
+		if (t0 < mstart || t2 >= mend)
+			continue;
+		bench_hist_record(sub, t1 - t0);
+		bench_hist_record(hp, t2 - t0);
+		if (ev.res == -EAGAIN)
+			eagain++;
+		ops++;
+	} while (t2 < mend);
+
+	bench_report(name, hp, "submit_p50", (double)bench_hist_pct(sub, 50.0),
+	    "submit_p99", (double)bench_hist_pct(sub, 99.0),
+	    "eagain_pct", ops == 0 ? 0.0 : 100.0 * eagain / ops, NULL);
+
+out:
+	if (grown > 0)
+		(void) ftruncate(fd, fsize);
+	(void) io_destroy(ctx);
+	aio_pool_destroy(pool);
+	bench_hist_free(sub);
+	bench_hist_free(hp);
+}
+
+static void
+sweep_rwflags(int argc, char **argv)
+{
+	struct rwflag *rf;
+	char name[80];
+	int fd;
+
+	for (rf = rwflags; rf->rf_name != NULL; rf++) {
+		(void) snprintf(name, sizeof (name), "aio.rwflags.%s",
+		    rf->rf_name);
+		if (!bench_selected(argc, argv, name))
+			continue;
+
+		if (fpath[0] == '\0')
+			make_file();
+		fd = open(fpath, (rf->rf_op == IOCB_CMD_PREAD ? O_RDONLY :
+		    O_RDWR) | rf->rf_oflags);
+		if (fd < 0 && rf->rf_oflags & O_DIRECT && errno == EINVAL) {
+			bench_skip(name, "O_DIRECT is not supported here");
+			continue;
+		}
+		if (fd < 0)
+			bench_fail(name, strerror(errno));
+		run_rwflag(name, fd, rf);
+		(void) close(fd);
+	}
+}
+
+/*
+ * State shared by the reapers of aio.pgetevents. Each reaper has its own
+ * context, so that every one of them wakes in every round, and keeps its own
+ * histogram and counts, merged once they've stopped.
+ */
+static struct pget {
+	int		pg_efd;		/* reapers post to this as they reap */
+	int		pg_mode;	/* PGET_NOSIG etc. */
+	uint64_t	pg_mstart;
+	uint64_t	pg_mend;
+	const char	*pg_name;
+} pget;
+
+#define	PGET_NOSIG	0	/* no signals are sent */
+#define	PGET_MASKED	1	/* SIGUSR1 is blocked while waiting */
+#define	PGET_UNMASKED	2	/* SIGUSR1 is unblocked while waiting */
+
+typedef struct pgreaper {
+	pthread_t	pr_tid;
+	aio_context_t	pr_ctx;
+	volatile uint64_t pr_stamp;	/* when its read was submitted */
+	volatile pid_t	pr_lwp;		/* for tgkill() */
+	bench_hist_t	*pr_hist;
+	uint64_t	pr_eintr;
+	uint64_t	pr_events;
+} pgreaper_t;
+
+static volatile uint64_t pget_handled;
+
+static void
+pget_sig(int sig)
+{
+	(void) __atomic_add_fetch(&pget_handled, 1, __ATOMIC_RELAXED);
+}
+
+static void *
+pget_reaper(void *arg)
+{
+	pgreaper_t *pr = arg;
+	struct io_event ev;
+	struct timespec ts = { 1, 0 };
+	sigset_t mask;
+	uint64_t now, one = 1;
+	int n;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	(void) pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+	if (pget.pg_mode != PGET_MASKED)
+		sigemptyset(&mask);
+	pr->pr_lwp = syscall(SYS_gettid);
+
+	for (;;) {
+		n = io_pgetevents(pr->pr_ctx, 1, 1, &ev, &ts, &mask);
+		if (n < 0 && errno == EINTR) {
+			pr->pr_eintr++;
+			continue;
+		}
+		if (n < 0)
+			bench_fail(pget.pg_name, strerror(errno));
+		if (n == 0)
+			continue;
+		now = bench_now();
+		if (ev.data == REAP_STOP)
+			break;
+		if (ev.res != MT_BS)
+			bench_fail(pget.pg_name, res_err(ev.res,
+			    "short read"));
+
+		if (now >= pget.pg_mstart && now < pget.pg_mend) {
+			bench_hist_record(pr->pr_hist, now - pr->pr_stamp);
+			pr->pr_events++;
+		}
+		if (write(pget.pg_efd, &one, sizeof (one)) != sizeof (one))
+			bench_fail(pget.pg_name, strerror(errno));
+	}
+	return (NULL);
+}
+
+/*
+ * Block 'nthr' threads in io_pgetevents(), each on its own context, and in
+ * each round, once rdv_blocked() shows that every one of them is back asleep
+ * in the wait, send them SIGUSR1 and at once submit a cached read to each
+ * context, which completes in io_submit(), then wait for them all to be
+ * reaped. The time recorded is from just before the submit until the
+ * reaper returns with its event. With 'masked', the mask given to
+ * io_pgetevents() blocks the signal, so the wait should carry on and the
+ * handler run once it's over; without, the wait is interrupted and the reaper
+ * has to go round again. A round whose reads aren't all reaped within
+ * PGET_LOST_MS, which only the reapers' timeout gets them out of, counts as a
+ * lost wakeup, and any signal sent and never handled as a lost signal.
+ */
+static void
+run_pget(const char *name, int fd, int nthr, int mode)
+{
+	pgreaper_t prs[PGET_MAX];
+	aio_pool_t *pool;
+	struct iocb *cbs[PGET_MAX];
+	struct io_event ev;
+	struct timespec ts = { 0, 0 };
+	struct sigaction sa, osa;
+	struct pollfd pfd;
+	sigset_t mask;
+	bench_hist_t *hp;
+	uint64_t v, t0, rounds = 0, lost = 0, sent = 0, eintr = 0, events = 0;
+	int i, rc, got;
+	double secs;
+
+	pget.pg_name = name;
+	pget.pg_mode = mode;
+	pget_handled = 0;
+	if ((hp = bench_hist_alloc()) == NULL ||
+	    (pool = aio_pool_create(nthr, MT_BS, 0)) == NULL)
+		bench_fail(name, "out of memory");
+	for (i = 0; i < nthr; i++) {
+		prs[i].pr_ctx = 0;
+		if (io_setup(1, &prs[i].pr_ctx) < 0)
+			bench_fail(name, strerror(errno));
+	}
+	sigemptyset(&mask);
+	if (io_pgetevents(prs[0].pr_ctx, 0, 1, &ev, &ts, &mask) < 0) {
+		if (errno != ENOSYS)
+			bench_fail(name, strerror(errno));
+		bench_skip(name, "io_pgetevents is not supported");
+		for (i = 0; i < nthr; i++)
+			(void) io_destroy(prs[i].pr_ctx);
+		aio_pool_destroy(pool);
+		bench_hist_free(hp);
+		return;
+	}
+	if ((pget.pg_efd = eventfd(0, 0)) < 0)
+		bench_fail(name, strerror(errno));
+
+	memset(&sa, 0, sizeof (sa));
+	sa.sa_handler = pget_sig;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGUSR1, &sa, &osa) != 0)
+		bench_fail(name, strerror(errno));
+
+	for (i = 0; i < nthr; i++) {
+		prs[i].pr_lwp = 0;
+		prs[i].pr_eintr = prs[i].pr_events = 0;
+		if ((prs[i].pr_hist = bench_hist_alloc()) == NULL)
+			bench_fail(name, "out of memory");
+		if (pthread_create(&prs[i].pr_tid, NULL, pget_reaper,
+		    &prs[i]) != 0)
+			bench_fail(name, "pthread_create failed");
+		cbs[i] = aio_pool_get(pool);
+		cbs[i]->aio_lio_opcode = IOCB_CMD_PREAD;
+		cbs[i]->aio_fildes = fd;
+	}
+	for (i = 0; i < nthr; i++) {
+		while (prs[i].pr_lwp == 0)
+			sched_yield();
+	}
+
+	pfd.fd = pget.pg_efd;
+	pfd.events = POLLIN;
+	pget.pg_mstart = bench_now() + bench_warmup();
+	pget.pg_mend = pget.pg_mstart + bench_runtime();
+	while ((t0 = bench_now()) < pget.pg_mend) {
+		for (i = 0; i < nthr; i++) {
+			if (rdv_blocked(prs[i].pr_lwp) != 0)
+				bench_fail(name, strerror(errno));
+		}
+		for (i = 0; i < nthr; i++) {
+			cbs[i]->aio_offset = rand_blk(&rng,
+			    fsize / MT_BS) * MT_BS;
+			if (mode == PGET_NOSIG)
+				continue;
+			if (syscall(SYS_tgkill, getpid(), prs[i].pr_lwp,
+			    SIGUSR1) != 0)
+				bench_fail(name, strerror(errno));
+			sent++;
+		}
+		for (i = 0; i < nthr; i++) {
+			prs[i].pr_stamp = bench_now();
+			if ((rc = io_submit(prs[i].pr_ctx, 1, &cbs[i])) != 1)
+				bench_fail(name, rc < 0 ? strerror(errno) :
+				    "partial submit");
+		}
+
+		for (got = 0; got < nthr; got += v) {
+			if ((rc = poll(&pfd, 1, PGET_LOST_MS)) == 0) {
+				if (t0 >= pget.pg_mstart)
+					lost++;
+				rc = poll(&pfd, 1, -1);
+			}
+			if (rc < 0 && errno != EINTR)
+				bench_fail(name, strerror(errno));
+			v = 0;
+			if (rc > 0 && read(pget.pg_efd, &v, sizeof (v)) !=
+			    sizeof (v))
+				bench_fail(name, strerror(errno));
+		}
+		if (t0 >= pget.pg_mstart)
+			rounds++;
+	}
+
+	for (i = 0; i < nthr; i++) {
+		cbs[i]->aio_data = REAP_STOP;
+		if (io_submit(prs[i].pr_ctx, 1, &cbs[i]) != 1)
+			bench_fail(name, strerror(errno));
+		(void) pthread_join(prs[i].pr_tid, NULL);
+		(void) io_destroy(prs[i].pr_ctx);
+		bench_hist_merge(hp, prs[i].pr_hist);
+		bench_hist_free(prs[i].pr_hist);
+		eintr += prs[i].pr_eintr;
+		events += prs[i].pr_events;
+	}
+
+	secs = (pget.pg_mend - pget.pg_mstart) / 1e9;
+	bench_report(name, hp, "reapers", (double)nthr,
+	    "signals_s", mode == PGET_NOSIG ? 0.0 : rounds * nthr / secs,
+	    "eintr_per_event", events == 0 ? 0.0 : (double)eintr / events,
+	    "wakeups_lost", (double)lost,
+	    "signals_lost", (double)(sent - pget_handled), NULL);
+
+	(void) sigaction(SIGUSR1, &osa, NULL);
+	(void) close(pget.pg_efd);
+	aio_pool_destroy(pool);
+	bench_hist_free(hp);
+}
+
+static void
+sweep_pget(int argc, char **argv)
+{
+	static const char *modes[] = { "nosig", "masked", "unmasked" };
+	char name[80];
+	int fd = -1, m, nthr;
+
+	for (m = PGET_NOSIG; m <= PGET_UNMASKED; m++) {
+		for (nthr = 1; nthr <= PGET_MAX; nthr *= 2) {
+			(void) snprintf(name, sizeof (name),
+			    "aio.pgetevents.%s.%d", modes[m], nthr);
+			if (!bench_selected(argc, argv, name))
+				continue;
+
+			if (fpath[0] == '\0')
+				make_file();
+			if (fd < 0 && (fd = open(fpath, O_RDONLY)) < 0)
+				bench_fail(name, strerror(errno));
+			run_pget(name, fd, nthr, m);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+/*
+ * A number from a /proc file: the first in the file, or with 'key', the one
+ * after it on the line starting with 'key'. Returns -1 if there's none.
+ */
+static long long
+proc_num(const char *path, const char *key)
+{
+	FILE *fp;
+	char line[256];
+	long long v = -1;
+	size_t len = key == NULL ? 0 : strlen(key);
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return (-1);
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if (key != NULL && strncmp(line, key, len) != 0)
+			continue;
+		if (sscanf(line + len, "%lld", &v) != 1)
+			v = -1;
+		break;
+	}
+	(void) fclose(fp);
+	return (v);
+}
+
+/* The size of the address space, or with 'rss' what's resident, in kB */
+static long long
+statm_kb(int rss)
+{
+	FILE *fp;
+	long long size, res;
+
+	if ((fp = fopen("/proc/self/statm", "r")) == NULL)
+		return (-1);
+	if (fscanf(fp, "%lld %lld", &size, &res) != 2)
+		size = res = -1;
+	(void) fclose(fp);
+	if (size < 0)
+		return (-1);
+	return ((rss ? res : size) * (sysconf(_SC_PAGESIZE) / 1024));
+}
+
+/* Kernel memory which contexts are made from, system wide */
+static long long
+kmem_kb()
+{
+	long long slab = proc_num("/proc/meminfo", "Slab:");
+	long long pcpu = proc_num("/proc/meminfo", "Percpu:");
+
+	return ((slab < 0 ? 0 : slab) + (pcpu < 0 ? 0 : pcpu));
+}
+
+typedef struct destroyer {
+	pthread_t	d_tid;
+	aio_context_t	*d_ctxs;
+	int		d_first;
+	int		d_n;
+	int		d_failed;
+} destroyer_t;
+
+static void *
+ctx_destroyer(void *arg)
+{
+	destroyer_t *dp = arg;
+	int i;
+
+	for (i = dp->d_first; i < dp->d_n; i += CTX_DESTROYERS) {
+		if (io_destroy(dp->d_ctxs[i]) != 0)
+			dp->d_failed++;
+	}
+	return (NULL);
+}
+
+/*
+ * Make up to CTX_MAX contexts of 'nr' events, or as many as aio-max-nr
+ * allows, timing each io_setup(), and see what they cost: address space,
+ * which is mostly the completion ring, whose pages are allocated up front
+ * although Linux doesn't count them as resident; resident memory; kernel
+ * memory (slab and per-CPU, which anything else on the system moves too);
+ * and how much of aio-max-nr each one takes up. Then destroy them all,
+ * CTX_DESTROYERS at a time, since io_destroy() waits for an RCU grace period,
+ * and report how far aio-nr is from where it started. aio-nr counts every
+ * context on the system, so others' coming and going moves that figure too.
+ */
+static void
+run_ctx(const char *name, int nr)
+{
+	aio_context_t *ctxs;
+	destroyer_t dps[CTX_DESTROYERS];
+	bench_hist_t *hp;
+	long long nr0, nr1, nr2, maxnr, vsz0, vsz1, rss0, rss1, rss2, km0, km1;
+	uint64_t t0, t1;
+	int i, n, limited = 0, failed = 0;
+
+	if ((ctxs = calloc(CTX_MAX, sizeof (aio_context_t))) == NULL ||
+	    (hp = bench_hist_alloc()) == NULL)
+		bench_fail(name, "out of memory");
+
+	maxnr = proc_num("/proc/sys/fs/aio-max-nr", NULL);
+	nr0 = proc_num("/proc/sys/fs/aio-nr", NULL);
+	vsz0 = statm_kb(0);
+	rss0 = statm_kb(1);
+	km0 = kmem_kb();
+	for (n = 0; n < CTX_MAX; n++) {
+		t0 = bench_now();
+		if (io_setup(nr, &ctxs[n]) != 0) {
+			if (errno != EAGAIN && errno != ENOMEM)
+				bench_fail(name, strerror(errno));
+			limited = 1;
+			break;
+		}
+		t1 = bench_now();
+		bench_hist_record(hp, t1 - t0);
+	}
+	nr1 = proc_num("/proc/sys/fs/aio-nr", NULL);
+	vsz1 = statm_kb(0);
+	rss1 = statm_kb(1);
+	km1 = kmem_kb();
+
+	if (n == 0) {
+		bench_skip(name, "no context of this size can be made");
+		goto out;
+	}
+
+	t0 = bench_now();
+	for (i = 0; i < CTX_DESTROYERS; i++) {
+		dps[i].d_ctxs = ctxs;
+		dps[i].d_first = i;
+		dps[i].d_n = n;
+		dps[i].d_failed = 0;
+		if (pthread_create(&dps[i].d_tid, NULL, ctx_destroyer,
+		    &dps[i]) != 0)
+			bench_fail(name, "pthread_create failed");
+	}
+	for (i = 0; i < CTX_DESTROYERS; i++) {
+		(void) pthread_join(dps[i].d_tid, NULL);
+		failed += dps[i].d_failed;
+	}
+	t1 = bench_now();
+	nr2 = proc_num("/proc/sys/fs/aio-nr", NULL);
+	rss2 = statm_kb(1);
+
+	if (failed != 0)
+		bench_fail(name, "io_destroy failed");
+
+	if (nr0 >= 0) {
+		bench_report(name, hp, "nr_events", (double)nr,
+		    "contexts", (double)n, "limited", (double)limited,
+		    "vsz_kb_per_ctx", (double)(vsz1 - vsz0) / n,
+		    "rss_kb_per_ctx", (double)(rss1 - rss0) / n,
+		    "kmem_kb_per_ctx", (double)(km1 - km0) / n,
+		    "aio_nr_per_ctx", (double)(nr1 - nr0) / n,
+		    "aio_max_nr", (double)maxnr,
+		    "destroy_ms", (t1 - t0) / 1e6,
+		    "rss_kb_left", (double)(rss2 - rss0),
+		    "aio_nr_left", (double)(nr2 - nr0), NULL);
+	} else {
+		bench_report(name, hp, "nr_events", (double)nr,
+		    "contexts", (double)n, "limited", (double)limited,
+		    "vsz_kb_per_ctx", (double)(vsz1 - vsz0) / n,
+		    "rss_kb_per_ctx", (double)(rss1 - rss0) / n,
+		    "kmem_kb_per_ctx", (double)(km1 - km0) / n,
+		    "destroy_ms", (t1 - t0) / 1e6,
+		    "rss_kb_left", (double)(rss2 - rss0), NULL);
+	}
+
+out:
+	bench_hist_free(hp);
+	free(ctxs);
+}
+
+static void
+sweep_ctx(int argc, char **argv)
+{
+	char name[80];
+	int nr;
+
+	for (nr = 1; nr <= CTX_NR_MAX; nr *= 8) {
+		(void) snprintf(name, sizeof (name), "aio.ctx.%d", nr);
+		if (bench_selected(argc, argv, name))
+			run_ctx(name, nr);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	bench_init();
+
+	sweep(argc, argv, "buffered", 0);
+	sweep(argc, argv, "direct", O_DIRECT);
+	sweep_mt(argc, argv);
+	sweep_reap(argc, argv);
+	sweep_efd(argc, argv);
+	sweep_ring(argc, argv);
+	sweep_batch(argc, argv);
+	sweep_vec(argc, argv);
+	sweep_kill(argc, argv);
+	sweep_ready(argc, argv);
+	sweep_rwflags(argc, argv);
+	sweep_pget(argc, argv);
+	sweep_ctx(argc, argv);
+	if (fpath[0] != '\0')
+		(void) unlink(fpath);
+
+	return (0);
+}
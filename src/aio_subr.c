@@ -0,0 +1,309 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Linux native aio, shared by the aio test and the aio benchmarks: wrappers
+ * for the syscalls, and a pool of preallocated iocbs and buffers.
+ */
+
+#define	_GNU_SOURCE
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "lxaio.h"
+
+int
+io_setup(int nr, aio_context_t *ctxp)
+{
+	return (syscall(SYS_io_setup, nr, ctxp));
+}
+
+int
+io_submit(aio_context_t ctx, long nr, struct iocb *cbpp[])
+{
+	return (syscall(SYS_io_submit, ctx, nr, cbpp));
+}
+
+int
+io_getevents(aio_context_t ctx, long minnr, long nr, struct io_event *ep,
+    struct timespec *tp)
+{
+	return (syscall(SYS_io_getevents, ctx, minnr, nr, ep, tp));
+}
+
+/* What the kernel takes in place of a sigset_t, and its idea of the size */
+struct aio_sigset {
+	const sigset_t	*as_mask;
+	size_t		as_size;
+};
+
+int
+io_pgetevents(aio_context_t ctx, long minnr, long nr, struct io_event *ep,
+    struct timespec *tp, const sigset_t *mask)
+{
+	struct aio_sigset as;
+
+	as.as_mask = mask;
+	as.as_size = _NSIG / 8;
+	return (syscall(SYS_io_pgetevents, ctx, minnr, nr, ep, tp,
+	    mask == NULL ? NULL : &as));
+}
+
+int
+io_cancel(aio_context_t ctx, struct iocb *cb, struct io_event *ep)
+{
+	return (syscall(SYS_io_cancel, ctx, cb, ep));
+}
+
+int
+io_destroy(aio_context_t ctx)
+{
+	return (syscall(SYS_io_destroy, ctx));
+}
+
+/*
+ * The pool is a single anonymous mapping: the aio_pool_t itself, the iocbs
+ * and a stack of free slot numbers, then the buffers starting on a page
+ * boundary. Each buffer is a multiple of 512 bytes, or of the page size if it
+ * is at least a page, so that every buffer is suitably aligned for O_DIRECT.
+ * The mapping is populated when it's made, so that neither page faults nor
+ * the allocator show up in the I/O paths which use it.
+ *
+ * The free slots are protected by a lock, since the aio test reaps and
+ * releases iocbs on threads other than the one which took them. A benchmark
+ * which wants no sharing at all can give each thread its own pool.
+ */
+
+#define	POOL_PGSZ	4096
+#define	POOL_HUGESZ	(2 * 1024 * 1024)
+
+#define	ROUNDUP(x, a)	(((x) + (a) - 1) / (a) * (a))
+
+struct aio_pool {
+	pthread_mutex_t	ap_lock;
+	size_t		ap_maplen;
+	size_t		ap_bufsz;
+	size_t		ap_stride;	/* between buffers */
+	int		ap_nslots;
+	int		ap_nfree;
+	int		*ap_free;	/* stack of free slot numbers */
+	struct iocb	*ap_cbs;
+	char		*ap_bufs;
+};
+
+aio_pool_t *
+aio_pool_create(int nslots, size_t bufsz, int flags)
+{
+	aio_pool_t *pp;
+	size_t stride, hdr, len;
+	char *base = MAP_FAILED;
+	int i;
+
+	if (nslots <= 0) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	stride = ROUNDUP(bufsz, bufsz < POOL_PGSZ ? 512 : POOL_PGSZ);
+	hdr = ROUNDUP(ROUNDUP(sizeof (aio_pool_t), 64) +
+	    nslots * (sizeof (struct iocb) + sizeof (int)), POOL_PGSZ);
+	len = hdr + nslots * stride;
+
+#ifdef MAP_HUGETLB
+	if (flags & AIO_POOL_HUGE) {
+		len = ROUNDUP(len, POOL_HUGESZ);
+		base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+		    -1, 0);
+	}
+#endif
+	if (base == MAP_FAILED) {
+		base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+		if (base == MAP_FAILED)
+			return (NULL);
+#ifdef MADV_HUGEPAGE
+		if (flags & AIO_POOL_HUGE)
+			(void) madvise(base, len, MADV_HUGEPAGE);
+#endif
+	}
+
+	/* The iocbs start on a cache line of their own */
+	pp = (aio_pool_t *)base;
+	pp->ap_maplen = len;
+	pp->ap_bufsz = bufsz;
+	pp->ap_stride = stride;
+	pp->ap_nslots = nslots;
+	pp->ap_cbs = (struct iocb *)(base + ROUNDUP(sizeof (aio_pool_t), 64));
+	pp->ap_free = (int *)(pp->ap_cbs + nslots);
+	pp->ap_bufs = base + hdr;
+	(void) pthread_mutex_init(&pp->ap_lock, NULL);
+
+	/* Hand out the low slots first */
+	for (i = 0; i < nslots; i++)
+		pp->ap_free[i] = nslots - 1 - i;
+	pp->ap_nfree = nslots;
+
+	return (pp);
+}
+
+void
+aio_pool_destroy(aio_pool_t *pp)
+{
+	if (pp == NULL)
+		return;
+	(void) pthread_mutex_destroy(&pp->ap_lock);
+	(void) munmap(pp, pp->ap_maplen);
+}
+
+/*
+ * Take an iocb from the pool. It is zeroed apart from aio_buf and aio_nbytes,
+ * which describe its own buffer.
+ */
+struct iocb *
+aio_pool_get(aio_pool_t *pp)
+{
+	struct iocb *cb;
+	int i;
+
+	(void) pthread_mutex_lock(&pp->ap_lock);
+	if (pp->ap_nfree == 0) {
+		(void) pthread_mutex_unlock(&pp->ap_lock);
+		return (NULL);
+	}
+	i = pp->ap_free[--pp->ap_nfree];
+	(void) pthread_mutex_unlock(&pp->ap_lock);
+
+	cb = &pp->ap_cbs[i];
+	(void) memset(cb, 0, sizeof (*cb));
+	cb->aio_buf = (uint64_t)(uintptr_t)(pp->ap_bufs + i * pp->ap_stride);
+	cb->aio_nbytes = pp->ap_bufsz;
+	return (cb);
+}
+
+/*
+ * Return an iocb to the pool. Its aio_buf may have been changed, since the
+ * buffer belongs to the slot rather than to whatever aio_buf points at.
+ */
+void
+aio_pool_put(aio_pool_t *pp, struct iocb *cb)
+{
+	int i = aio_pool_slot(pp, cb);
+
+	if (i < 0)
+		return;
+	(void) pthread_mutex_lock(&pp->ap_lock);
+	pp->ap_free[pp->ap_nfree++] = i;
+	(void) pthread_mutex_unlock(&pp->ap_lock);
+}
+
+/* The slot number of an iocb from the pool, or -1 if it isn't from the pool */
+int
+aio_pool_slot(aio_pool_t *pp, struct iocb *cb)
+{
+	if (cb < pp->ap_cbs || cb >= pp->ap_cbs + pp->ap_nslots)
+		return (-1);
+	return (cb - pp->ap_cbs);
+}
+
+/*
+ * The completion ring. Linux maps this at the address that io_setup() returns
+ * as the context; the events follow the header, and the kernel adds them at
+ * 'tail' while whoever reaps takes them from 'head', both of which are kept
+ * below 'nr'. An lx zone doesn't emulate the ring, which aio_ring_usable()
+ * detects from the magic number, as libaio does.
+ */
+#define	AIO_RING_MAGIC	0xa10a10a1
+
+struct aio_ring {
+	unsigned	r_id;
+	unsigned	r_nr;
+	unsigned	r_head;
+	unsigned	r_tail;
+	unsigned	r_magic;
+	unsigned	r_compat;
+	unsigned	r_incompat;
+	unsigned	r_hdrlen;
+	struct io_event	r_events[];
+};
+
+int
+aio_ring_usable(aio_context_t ctx)
+{
+	struct aio_ring *rp = (struct aio_ring *)(uintptr_t)ctx;
+
+	return (rp != NULL && rp->r_magic == AIO_RING_MAGIC &&
+	    rp->r_incompat == 0 && rp->r_hdrlen == sizeof (struct aio_ring));
+}
+
+/*
+ * Take up to 'nr' completions from the ring without a syscall, returning how
+ * many were taken, or -1 with errno set to ENOSYS if the ring isn't usable.
+ * Any number of threads may reap the same ring this way at once: each copies
+ * the events out and then claims them by moving the head on with a
+ * compare-and-swap, starting again if another thread got there first. The
+ * kernel can't reuse the slots until the head has moved past them, so the
+ * copy is good if the claim succeeds.
+ */
+int
+aio_ring_reap(aio_context_t ctx, long nr, struct io_event *ep)
+{
+	struct aio_ring *rp = (struct aio_ring *)(uintptr_t)ctx;
+	unsigned head, tail, n, i;
+
+	if (!aio_ring_usable(ctx)) {
+		errno = ENOSYS;
+		return (-1);
+	}
+
+	do {
+		head = __atomic_load_n(&rp->r_head, __ATOMIC_ACQUIRE);
+		/* The events are written before the tail is moved on */
+		tail = __atomic_load_n(&rp->r_tail, __ATOMIC_ACQUIRE);
+		if (head == tail)
+			return (0);
+
+		n = (tail + rp->r_nr - head) % rp->r_nr;
+		if (n > nr)
+			n = nr;
+		for (i = 0; i < n; i++)
+			ep[i] = rp->r_events[(head + i) % rp->r_nr];
+	} while (!__atomic_compare_exchange_n(&rp->r_head, &head,
+	    (head + n) % rp->r_nr, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	return (n);
+}
+
+/*
+ * io_getevents(), but taking what it can from the ring first and only making
+ * the syscall if it needs to wait for more. The kernel moves the head on
+ * without regard to anyone reaping the ring in user space, so while this may
+ * make the syscall, no other thread may reap the same context at the same
+ * time.
+ */
+int
+aio_ring_getevents(aio_context_t ctx, long min_nr, long nr,
+    struct io_event *ep, struct timespec *tp)
+{
+	int n, rc;
+
+	if ((n = aio_ring_reap(ctx, nr, ep)) < 0)
+		return (io_getevents(ctx, min_nr, nr, ep, tp));
+	if (n >= min_nr)
+		return (n);
+
+	if ((rc = io_getevents(ctx, min_nr - n, nr - n, ep + n, tp)) < 0)
+		return (n > 0 ? n : rc);
+	return (n + rc);
+}
@@ -0,0 +1,399 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Generate a mixed read and write workload with Linux native aio, for
+ * reproducing an application's access pattern without needing fio.
+ *
+ * usage: aioload [-DH] [-b bsize] [-f file] [-i interval] [-q qdepth]
+ *	[-r read%] [-s fsize] [-t secs] [-z theta]
+ *
+ *	-D	open the file with O_DIRECT
+ *	-H	print the full latency histograms at the end
+ *	-b	block size; the default is 4k
+ *	-f	file to use; by default a temporary one is made and removed
+ *	-i	seconds between progress lines; the default is 1, 0 for none
+ *	-q	number of I/Os kept in flight; the default is 32
+ *	-r	percentage of I/Os which are reads; the default is 100
+ *	-s	size of the file; the default is 64m
+ *	-t	seconds to run for; the default is 10
+ *	-z	pick blocks from a zipfian distribution with this theta, which
+ *		must be between 0 and 1, e.g. 0.99; the default is uniform
+ *
+ * Sizes may have a k, m or g suffix. A file named with -f is filled with
+ * pattern data up to the given size if it's shorter.
+ *
+ * Every interval, a PROGRESS line shows the read and write IOPS and MB/s over
+ * that interval. At the end, a BENCH line for each of aioload.read and
+ * aioload.write gives the latency percentiles, from submission to reaping,
+ * and the overall IOPS and MB/s, in the same form as the benchmarks, so that
+ * the output can be given to benchreport. With -H, each is followed by HIST
+ * lines giving the count in each non-empty histogram bucket.
+ *
+ * The zipfian generator is that of Gray et al, "Quickly Generating
+ * Billion-Record Synthetic Databases", with the ranks it picks scattered over
+ * the file by a multiplicative hash, so that the hot blocks aren't all at the
+ * start.
+ */
+
+#define	_GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "lxtst.h"
+#include "lxaio.h"
+#include "lxbench.h"
+
+#define	FILL_CHUNK	(1024 * 1024)
+
+typedef struct dir {
+	const char	*d_name;
+	bench_hist_t	*d_hist;
+	uint64_t	d_ops;		/* over the whole run */
+	uint64_t	d_iops;		/* over the current interval */
+} dir_t;
+
+static char *progname;
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+/* The zipfian generator's constants */
+static double z_theta, z_zetan, z_alpha, z_eta;
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s [-DH] [-b bsize] [-f file] [-i interval] "
+	    "[-q qdepth]\n\t[-r read%%] [-s fsize] [-t secs] [-z theta]\n",
+	    progname);
+	exit(2);
+}
+
+static void
+fatal(const char *msg)
+{
+	fprintf(stderr, "%s: %s: %s\n", progname, msg, strerror(errno));
+	exit(1);
+}
+
+/* A size with an optional k, m or g suffix */
+static uint64_t
+parse_size(const char *s)
+{
+	char *end;
+	uint64_t v = strtoull(s, &end, 10);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		v <<= 10;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		v <<= 20;
+		end++;
+		break;
+	case 'g':
+	case 'G':
+		v <<= 30;
+		end++;
+		break;
+	}
+	if (*end != '\0' || v == 0)
+		usage();
+	return (v);
+}
+
+/* xorshift64 */
+static uint64_t
+rand64()
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return (rng);
+}
+
+/* Uniform in [0, 1) */
+static double
+rand_unit()
+{
+	return ((rand64() >> 11) * (1.0 / (1ULL << 53)));
+}
+
+static void
+zipf_init(uint64_t n, double theta)
+{
+	double zeta2 = 1.0 + pow(0.5, theta);
+	uint64_t i;
+
+	z_theta = theta;
+	for (z_zetan = 0, i = 1; i <= n; i++)
+		z_zetan += 1.0 / pow((double)i, theta);
+	z_alpha = 1.0 / (1.0 - theta);
+	z_eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z_zetan);
+}
+
+static uint64_t
+zipf_next(uint64_t n)
+{
+	double u = rand_unit(), uz = u * z_zetan;
+	uint64_t rank;
+
+	if (uz < 1.0)
+		rank = 0;
+	else if (uz < 1.0 + pow(0.5, z_theta))
+		rank = 1;
+	else
+		rank = (uint64_t)(n * pow(z_eta * u - z_eta + 1.0, z_alpha));
+	if (rank >= n)
+		rank = n - 1;
+
+	/* Scatter the ranks over the file */
+	return ((rank * 0x9e3779b97f4a7c15ULL) % n);
+}
+
+/* Make sure that 'path' is at least 'size' bytes, filling it if need be */
+static void
+fill_file(const char *path, uint64_t size)
+{
+	struct stat sb;
+	uint64_t off;
+	char *buf;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT, 0644)) < 0)
+		fatal(path);
+	if (fstat(fd, &sb) != 0)
+		fatal(path);
+	if ((buf = malloc(FILL_CHUNK)) == NULL)
+		fatal("malloc");
+
+	for (off = sb.st_size / FILL_CHUNK * FILL_CHUNK; off < size;
+	    off += FILL_CHUNK) {
+		pattern_fill(buf, FILL_CHUNK, off);
+		if (pwrite(fd, buf, FILL_CHUNK, off) != FILL_CHUNK)
+			fatal(path);
+	}
+	if (fsync(fd) != 0)
+		fatal(path);
+
+	free(buf);
+	(void) close(fd);
+}
+
+static void
+prep(struct iocb *cb, int fd, uint64_t nblks, size_t bs, int rpct)
+{
+	uint64_t blk = z_theta > 0 ? zipf_next(nblks) : rand64() % nblks;
+
+	cb->aio_lio_opcode = rand64() % 100 < rpct ? IOCB_CMD_PREAD :
+	    IOCB_CMD_PWRITE;
+	cb->aio_fildes = fd;
+	cb->aio_offset = blk * bs;
+}
+
+static void
+report(dir_t *dp, double secs, size_t bs, int hist)
+{
+	int i;
+
+	bench_report(dp->d_name, dp->d_hist, "iops", dp->d_ops / secs,
+	    "mb_s", dp->d_ops * bs / secs / (1024 * 1024), NULL);
+	if (!hist)
+		return;
+	for (i = 0; i < BENCH_NBUCKETS; i++) {
+		if (dp->d_hist->bh_buckets[i] != 0) {
+			printf("HIST %s %llu %llu\n", dp->d_name,
+			    (unsigned long long)bench_hist_value(i),
+			    (unsigned long long)dp->d_hist->bh_buckets[i]);
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	char tmp[64], *path = NULL;
+	uint64_t fsize = 64 << 20, bs = 4096, nblks, now, start, end, next;
+	uint64_t *stamp, ivl_start;
+	int qd = 32, rpct = 100, secs = 10, ivl = 1, oflags = 0, hist = 0;
+	double theta = 0;
+	aio_context_t ctx = 0;
+	aio_pool_t *pool;
+	struct iocb **cbs;
+	struct io_event *evs;
+	dir_t dirs[2];
+	int c, fd, i, n, k, inflight;
+
+	progname = argv[0];
+	while ((c = getopt(argc, argv, "DHb:f:i:q:r:s:t:z:")) != -1) {
+		switch (c) {
+		case 'D':
+			oflags |= O_DIRECT;
+			break;
+		case 'H':
+			hist = 1;
+			break;
+		case 'b':
+			bs = parse_size(optarg);
+			break;
+		case 'f':
+			path = optarg;
+			break;
+		case 'i':
+			ivl = atoi(optarg);
+			break;
+		case 'q':
+			qd = atoi(optarg);
+			break;
+		case 'r':
+			rpct = atoi(optarg);
+			break;
+		case 's':
+			fsize = parse_size(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		case 'z':
+			theta = atof(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || qd < 1 || rpct < 0 || rpct > 100 || secs < 1 ||
+	    ivl < 0 || theta < 0 || theta >= 1 || fsize < bs)
+		usage();
+
+	nblks = fsize / bs;
+	if (theta > 0)
+		zipf_init(nblks, theta);
+
+	if (path == NULL) {
+		(void) snprintf(tmp, sizeof (tmp), "lxtmp-aioload.%d",
+		    (int)getpid());
+		path = tmp;
+	}
+	fill_file(path, fsize);
+	if ((fd = open(path, O_RDWR | oflags)) < 0)
+		fatal(path);
+
+	dirs[0].d_name = "aioload.read";
+	dirs[1].d_name = "aioload.write";
+	for (i = 0; i < 2; i++) {
+		dirs[i].d_ops = dirs[i].d_iops = 0;
+		if ((dirs[i].d_hist = bench_hist_alloc()) == NULL)
+			fatal("malloc");
+	}
+	stamp = calloc(qd, sizeof (uint64_t));
+	cbs = calloc(qd, sizeof (struct iocb *));
+	evs = calloc(qd, sizeof (struct io_event));
+	if (stamp == NULL || cbs == NULL || evs == NULL)
+		fatal("calloc");
+	if ((pool = aio_pool_create(qd, bs, AIO_POOL_HUGE)) == NULL)
+		fatal("aio_pool_create");
+	if (io_setup(qd, &ctx) != 0)
+		fatal("io_setup");
+
+	bench_init();
+
+	for (i = 0; i < qd; i++) {
+		cbs[i] = aio_pool_get(pool);
+		cbs[i]->aio_data = aio_pool_slot(pool, cbs[i]);
+		pattern_fill((void *)(uintptr_t)cbs[i]->aio_buf, bs, i);
+		prep(cbs[i], fd, nblks, bs, rpct);
+	}
+
+	start = bench_now();
+	end = start + secs * 1000000000ULL;
+	ivl_start = start;
+	next = ivl > 0 ? start + ivl * 1000000000ULL : UINT64_MAX;
+
+	k = qd;
+	inflight = 0;
+	for (;;) {
+		/* Submit what was reaped last time round, all at once */
+		for (i = 0; i < k; i++)
+			stamp[cbs[i]->aio_data] = bench_now();
+		for (i = 0; i < k; i += n) {
+			if ((n = io_submit(ctx, k - i, cbs + i)) < 0) {
+				if (errno == EAGAIN || errno == EINTR) {
+					n = 0;
+					continue;
+				}
+				fatal("io_submit");
+			}
+		}
+		inflight += k;
+		if (inflight == 0)
+			break;
+
+		if ((n = io_getevents(ctx, 1, qd, evs, NULL)) < 0) {
+			if (errno != EINTR)
+				fatal("io_getevents");
+			n = 0;
+		}
+		now = bench_now();
+		inflight -= n;
+
+		for (i = k = 0; i < n; i++) {
+			struct iocb *cb = (struct iocb *)(uintptr_t)evs[i].obj;
+			dir_t *dp = &dirs[cb->aio_lio_opcode == IOCB_CMD_PREAD ?
+			    0 : 1];
+
+			if (evs[i].res != bs) {
+				errno = evs[i].res < 0 ? -evs[i].res : EIO;
+				fatal(dp == &dirs[0] ? "read" : "write");
+			}
+			bench_hist_record(dp->d_hist,
+			    now - stamp[evs[i].data]);
+			dp->d_ops++;
+			dp->d_iops++;
+			if (now < end) {
+				prep(cb, fd, nblks, bs, rpct);
+				cbs[k++] = cb;
+			}
+		}
+
+		if (now >= next) {
+			double t = (now - ivl_start) / 1e9;
+
+			printf("PROGRESS aioload t=%.1f read_iops=%.0f "
+			    "write_iops=%.0f read_mb_s=%.1f write_mb_s=%.1f\n",
+			    (now - start) / 1e9, dirs[0].d_iops / t,
+			    dirs[1].d_iops / t,
+			    dirs[0].d_iops * bs / t / (1024 * 1024),
+			    dirs[1].d_iops * bs / t / (1024 * 1024));
+			(void) fflush(stdout);
+			dirs[0].d_iops = dirs[1].d_iops = 0;
+			ivl_start = now;
+			next = now + ivl * 1000000000ULL;
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (dirs[i].d_ops > 0)
+			report(&dirs[i], secs, bs, hist);
+	}
+
+	(void) io_destroy(ctx);
+	(void) close(fd);
+	if (path == tmp)
+		(void) unlink(path);
+	return (0);
+}
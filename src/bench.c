@@ -0,0 +1,469 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Micro-benchmark support.
+ *
+ * A benchmark result is printed as a single line:
+ *
+ *	BENCH name n=<samples> min=<ns> mean=<ns> p50=<ns> p99=<ns> \
+ *	    p99.9=<ns> max=<ns> [key=value ...]
+ *
+ * All times are in nanoseconds. Before any results, bench_init() prints a
+ * BENCHENV line of key=value pairs describing the system, so that results
+ * from native Linux and from lx can be told apart and compared.
+ *
+ * The following environment variables control how benchmarks run:
+ *
+ *	LXTST_BENCH_TIME	milliseconds to measure each benchmark for
+ *	LXTST_BENCH_WARMUP	milliseconds to run before measuring
+ *	LXTST_BENCH_CPU		CPU to pin the benchmark to
+ *	LXTST_BENCH_STORE	result store to append each result to
+ *	LXTST_BENCH_BUILD	platform build to record results against
+ *
+ * Each record in the result store is a single line:
+ *
+ *	1 <build> <host> <name> <time> <n> <sum> <min> <max> <idx>:<count>,...
+ *
+ * where the last field lists the non-empty histogram buckets. Records are
+ * only ever appended, each with a single write(2), so a store can be shared by
+ * benchmarks running on several systems. See benchstore.c.
+ */
+
+#define	_GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include "lxbench.h"
+
+#define	DFLT_TIME	1000		/* ms */
+#define	DFLT_WARMUP	100		/* ms */
+#define	MIN_SAMPLE	1000		/* ns, shortest useful timed sample */
+#define	MAX_BATCH	(1ULL << 30)
+
+static uint64_t runtime = DFLT_TIME * 1000000ULL;
+static uint64_t warmup = DFLT_WARMUP * 1000000ULL;
+static uint64_t clock_cost;
+static int pinned_cpu = -1;
+static char *store_path;
+static char build[128];
+static char host[256];
+
+uint64_t
+bench_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+int
+bench_hist_index(uint64_t v)
+{
+	int e;
+
+	if (v < BENCH_SUB)
+		return ((int)v);
+
+	/* Keep the top BENCH_SUB_BITS bits of the value */
+	e = 63 - __builtin_clzll(v);
+	return (BENCH_SUB + (e - BENCH_SUB_BITS) * (BENCH_SUB / 2) +
+	    (int)((v >> (e - BENCH_SUB_BITS + 1)) - BENCH_SUB / 2));
+}
+
+/* The largest value which falls into the given bucket */
+uint64_t
+bench_hist_value(int idx)
+{
+	int shift;
+	uint64_t m;
+
+	if (idx < BENCH_SUB)
+		return ((uint64_t)idx);
+
+	idx -= BENCH_SUB;
+	shift = idx / (BENCH_SUB / 2) + 1;
+	m = idx % (BENCH_SUB / 2) + BENCH_SUB / 2;
+	return ((m << shift) + ((1ULL << shift) - 1));
+}
+
+void
+bench_hist_reset(bench_hist_t *hp)
+{
+	memset(hp, 0, sizeof (*hp));
+	hp->bh_min = UINT64_MAX;
+}
+
+bench_hist_t *
+bench_hist_alloc()
+{
+	bench_hist_t *hp;
+
+	if ((hp = malloc(sizeof (bench_hist_t))) == NULL)
+		bench_fail("bench", "histogram allocation failed");
+	bench_hist_reset(hp);
+	return (hp);
+}
+
+void
+bench_hist_free(bench_hist_t *hp)
+{
+	free(hp);
+}
+
+void
+bench_hist_record(bench_hist_t *hp, uint64_t v)
+{
+	hp->bh_buckets[bench_hist_index(v)]++;
+	hp->bh_count++;
+	hp->bh_sum += v;
+	if (v < hp->bh_min)
+		hp->bh_min = v;
+	if (v > hp->bh_max)
+		hp->bh_max = v;
+}
+
+void
+bench_hist_merge(bench_hist_t *dst, const bench_hist_t *src)
+{
+	int i;
+
+	if (src->bh_count == 0)
+		return;
+
+	for (i = 0; i < BENCH_NBUCKETS; i++)
+		dst->bh_buckets[i] += src->bh_buckets[i];
+	dst->bh_count += src->bh_count;
+	dst->bh_sum += src->bh_sum;
+	if (src->bh_min < dst->bh_min)
+		dst->bh_min = src->bh_min;
+	if (src->bh_max > dst->bh_max)
+		dst->bh_max = src->bh_max;
+}
+
+uint64_t
+bench_hist_pct(const bench_hist_t *hp, double pct)
+{
+	uint64_t rank, n = 0, v;
+	int i;
+
+	if (hp->bh_count == 0)
+		return (0);
+
+	rank = (uint64_t)(pct / 100.0 * hp->bh_count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < BENCH_NBUCKETS; i++) {
+		n += hp->bh_buckets[i];
+		if (n >= rank)
+			break;
+	}
+
+	/* The exact extremes are better than the bucket bound */
+	v = bench_hist_value(i);
+	if (v > hp->bh_max)
+		v = hp->bh_max;
+	if (v < hp->bh_min)
+		v = hp->bh_min;
+	return (v);
+}
+
+uint64_t
+bench_hist_mean(const bench_hist_t *hp)
+{
+	if (hp->bh_count == 0)
+		return (0);
+	return (hp->bh_sum / hp->bh_count);
+}
+
+void
+bench_fail(const char *name, const char *msg)
+{
+	printf("FAIL %s: %s\n", name, msg);
+	exit(1);
+}
+
+void
+bench_skip(const char *name, const char *why)
+{
+	printf("SKIP %s: %s\n", name, why);
+	fflush(stdout);
+}
+
+uint64_t
+bench_runtime()
+{
+	return (runtime);
+}
+
+uint64_t
+bench_warmup()
+{
+	return (warmup);
+}
+
+int
+bench_pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return (sched_setaffinity(0, sizeof (set), &set));
+}
+
+int
+bench_selected(int argc, char **argv, const char *name)
+{
+	int i;
+
+	if (argc <= 1)
+		return (1);
+	for (i = 1; i < argc; i++) {
+		if (strncmp(argv[i], name, strlen(argv[i])) == 0)
+			return (1);
+	}
+	return (0);
+}
+
+static uint64_t
+env_ms(const char *var, uint64_t dflt)
+{
+	char *s, *e;
+	unsigned long v;
+
+	if ((s = getenv(var)) == NULL || *s == '\0')
+		return (dflt);
+	errno = 0;
+	v = strtoul(s, &e, 10);
+	if (errno != 0 || *e != '\0') {
+		fprintf(stderr, "invalid %s: %s\n", var, s);
+		exit(1);
+	}
+	return (v * 1000000ULL);
+}
+
+/* Replace white space, so the string can be used as a field. */
+static void
+fieldify(char *s)
+{
+	for (; *s != '\0'; s++) {
+		if (*s == ' ' || *s == '\t' || *s == '\n')
+			*s = '_';
+	}
+}
+
+/* Print a string value with any white space replaced. */
+static void
+env_str(const char *key, const char *val)
+{
+	printf(" %s=", key);
+	if (*val == '\0')
+		val = "-";
+	for (; *val != '\0'; val++)
+		putchar((*val == ' ' || *val == '\t') ? '_' : *val);
+}
+
+/*
+ * Identify the platform build. On native Linux that's the kernel release. In
+ * an lx zone the emulated release is fixed, so use the build stamp of the
+ * platform underneath.
+ */
+static void
+get_build(struct utsname *np, int lx)
+{
+	char *s;
+	FILE *f;
+	char buf[80];
+
+	if ((s = getenv("LXTST_BENCH_BUILD")) != NULL && *s != '\0') {
+		(void) snprintf(build, sizeof (build), "%s", s);
+	} else if (!lx) {
+		(void) snprintf(build, sizeof (build), "linux-%s",
+		    np->release);
+	} else {
+		buf[0] = '\0';
+		if ((f = popen("/native/usr/bin/uname -v 2>/dev/null",
+		    "r")) != NULL) {
+			if (fgets(buf, sizeof (buf), f) == NULL)
+				buf[0] = '\0';
+			(void) pclose(f);
+		}
+		buf[strcspn(buf, "\n")] = '\0';
+		(void) snprintf(build, sizeof (build), "lx-%s",
+		    buf[0] != '\0' ? buf : np->release);
+	}
+	fieldify(build);
+}
+
+/* Append a record of the result to the store. */
+static void
+store_result(const char *name, const bench_hist_t *hp)
+{
+	char *buf = NULL, *nm;
+	size_t len = 0;
+	FILE *f;
+	int fd, i, first = 1;
+
+	if ((nm = strdup(name)) == NULL ||
+	    (f = open_memstream(&buf, &len)) == NULL)
+		bench_fail(name, "unable to allocate store record");
+	fieldify(nm);
+
+	fprintf(f, "1 %s %s %s %ld %llu %llu %llu %llu ", build, host, nm,
+	    (long)time(NULL), (unsigned long long)hp->bh_count,
+	    (unsigned long long)hp->bh_sum,
+	    (unsigned long long)(hp->bh_count == 0 ? 0 : hp->bh_min),
+	    (unsigned long long)hp->bh_max);
+	for (i = 0; i < BENCH_NBUCKETS; i++) {
+		if (hp->bh_buckets[i] == 0)
+			continue;
+		fprintf(f, "%s%d:%llu", first ? "" : ",", i,
+		    (unsigned long long)hp->bh_buckets[i]);
+		first = 0;
+	}
+	fprintf(f, "%s\n", first ? "-" : "");
+	(void) fclose(f);
+
+	if ((fd = open(store_path, O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0 ||
+	    write(fd, buf, len) != (ssize_t)len)
+		bench_fail(name, "unable to write to result store");
+	(void) close(fd);
+
+	free(buf);
+	free(nm);
+}
+
+void
+bench_init()
+{
+	struct utsname nm;
+	char *s;
+	int i, lx;
+	uint64_t t0, t1, d;
+
+	runtime = env_ms("LXTST_BENCH_TIME", runtime);
+	warmup = env_ms("LXTST_BENCH_WARMUP", warmup);
+
+	if ((s = getenv("LXTST_BENCH_CPU")) != NULL && *s != '\0') {
+		pinned_cpu = atoi(s);
+		if (bench_pin(pinned_cpu) != 0) {
+			fprintf(stderr, "unable to bind to CPU %d: %s\n",
+			    pinned_cpu, strerror(errno));
+			exit(1);
+		}
+	}
+
+	/* The cheapest back-to-back clock reading */
+	clock_cost = UINT64_MAX;
+	for (i = 0; i < 1000; i++) {
+		t0 = bench_now();
+		t1 = bench_now();
+		d = t1 - t0;
+		if (d < clock_cost)
+			clock_cost = d;
+	}
+
+	if ((s = getenv("LXTST_BENCH_STORE")) != NULL && *s != '\0')
+		store_path = s;
+
+	uname(&nm);
+	lx = (strstr(nm.version, "BrandZ") != NULL);
+	if (gethostname(host, sizeof (host)) != 0)
+		strcpy(host, "unknown");
+	host[sizeof (host) - 1] = '\0';
+	fieldify(host);
+	get_build(&nm, lx);
+
+	printf("BENCHENV");
+	env_str("platform", lx ? "lx" : "linux");
+	env_str("build", build);
+	env_str("release", nm.release);
+	env_str("version", nm.version);
+	env_str("host", host);
+	printf(" ncpus=%ld cpu=%d clock_ns=%llu\n",
+	    sysconf(_SC_NPROCESSORS_ONLN), pinned_cpu,
+	    (unsigned long long)clock_cost);
+	fflush(stdout);
+}
+
+void
+bench_report(const char *name, const bench_hist_t *hp, ...)
+{
+	va_list ap;
+	const char *key;
+
+	printf("BENCH %s n=%llu min=%llu mean=%llu p50=%llu p99=%llu "
+	    "p99.9=%llu max=%llu", name,
+	    (unsigned long long)hp->bh_count,
+	    (unsigned long long)(hp->bh_count == 0 ? 0 : hp->bh_min),
+	    (unsigned long long)bench_hist_mean(hp),
+	    (unsigned long long)bench_hist_pct(hp, 50.0),
+	    (unsigned long long)bench_hist_pct(hp, 99.0),
+	    (unsigned long long)bench_hist_pct(hp, 99.9),
+	    (unsigned long long)hp->bh_max);
+
+	va_start(ap, hp);
+	while ((key = va_arg(ap, const char *)) != NULL)
+		printf(" %s=%.6g", key, va_arg(ap, double));
+	va_end(ap);
+
+	putchar('\n');
+	fflush(stdout);
+
+	if (store_path != NULL)
+		store_result(name, hp);
+}
+
+void
+bench_run(const char *name, bench_func_t fn, void *arg)
+{
+	bench_hist_t *hp;
+	uint64_t batch, target, start, t0, t1;
+
+	/*
+	 * Find a batch size which makes a sample long enough that reading the
+	 * clock is lost in the noise.
+	 */
+	target = clock_cost * 100;
+	if (target < MIN_SAMPLE)
+		target = MIN_SAMPLE;
+	for (batch = 1; batch < MAX_BATCH; batch *= 2) {
+		t0 = bench_now();
+		fn(arg, batch);
+		t1 = bench_now();
+		if (t1 - t0 >= target)
+			break;
+	}
+
+	start = bench_now();
+	while (bench_now() - start < warmup)
+		fn(arg, batch);
+
+	hp = bench_hist_alloc();
+	start = bench_now();
+	do {
+		t0 = bench_now();
+		fn(arg, batch);
+		t1 = bench_now();
+		bench_hist_record(hp, (t1 - t0) / batch);
+	} while (t1 - start < runtime);
+
+	bench_report(name, hp, "batch", (double)batch, NULL);
+	bench_hist_free(hp);
+}
@@ -0,0 +1,220 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Compare benchmark results from two systems.
+ *
+ * Each file is the saved output of 'make bench' (or of individual benchmark
+ * programs). The first is the baseline, normally a run on native Linux, and
+ * the second the system being compared against it, normally an lx zone. Each
+ * benchmark found in both is printed with its median, mean and 99th percentile
+ * on each system and the ratio of the second to the first; a ratio above 1 is
+ * a slowdown. If a benchmark was run more than once in a file, the average of
+ * its runs is used.
+ *
+ * usage: benchreport baseline-file compare-file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define	MAX_LINE	4096
+#define	NSTATS		3
+
+static const char *stat_keys[NSTATS] = { "p50", "mean", "p99" };
+
+typedef struct result {
+	char		*r_name;
+	int		r_runs;
+	double		r_stat[NSTATS];
+	struct result	*r_next;
+} result_t;
+
+typedef struct rfile {
+	const char	*f_path;
+	char		f_platform[64];
+	char		f_release[128];
+	result_t	*f_results;	/* in the order first seen */
+	result_t	*f_last;
+} rfile_t;
+
+static char *progname;
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s baseline-file compare-file\n", progname);
+	exit(2);
+}
+
+static result_t *
+find_result(rfile_t *fp, const char *name)
+{
+	result_t *rp;
+
+	for (rp = fp->f_results; rp != NULL; rp = rp->r_next) {
+		if (strcmp(rp->r_name, name) == 0)
+			return (rp);
+	}
+	return (NULL);
+}
+
+static void
+parse_env(rfile_t *fp, char *line)
+{
+	char *tok, *lasts;
+
+	for (tok = strtok_r(line, " \n", &lasts); tok != NULL;
+	    tok = strtok_r(NULL, " \n", &lasts)) {
+		if (strncmp(tok, "platform=", 9) == 0) {
+			(void) snprintf(fp->f_platform,
+			    sizeof (fp->f_platform), "%s", tok + 9);
+		} else if (strncmp(tok, "release=", 8) == 0) {
+			(void) snprintf(fp->f_release,
+			    sizeof (fp->f_release), "%s", tok + 8);
+		}
+	}
+}
+
+static void
+parse_bench(rfile_t *fp, char *line)
+{
+	char *name, *tok, *lasts, *val;
+	double stat[NSTATS];
+	int i, found = 0;
+	result_t *rp;
+
+	if ((name = strtok_r(line, " \n", &lasts)) == NULL)
+		return;
+
+	while ((tok = strtok_r(NULL, " \n", &lasts)) != NULL) {
+		if ((val = strchr(tok, '=')) == NULL)
+			continue;
+		*val++ = '\0';
+		for (i = 0; i < NSTATS; i++) {
+			if (strcmp(tok, stat_keys[i]) == 0) {
+				stat[i] = strtod(val, NULL);
+				found |= 1 << i;
+			}
+		}
+	}
+	if (found != (1 << NSTATS) - 1)
+		return;
+
+	if ((rp = find_result(fp, name)) == NULL) {
+		if ((rp = calloc(1, sizeof (result_t))) == NULL ||
+		    (rp->r_name = strdup(name)) == NULL) {
+			perror("benchreport");
+			exit(1);
+		}
+		if (fp->f_last == NULL)
+			fp->f_results = rp;
+		else
+			fp->f_last->r_next = rp;
+		fp->f_last = rp;
+	}
+	for (i = 0; i < NSTATS; i++)
+		rp->r_stat[i] += stat[i];
+	rp->r_runs++;
+}
+
+static void
+load(rfile_t *fp, const char *path)
+{
+	FILE *f;
+	char line[MAX_LINE];
+	result_t *rp;
+	int i;
+
+	fp->f_path = path;
+	(void) strcpy(fp->f_platform, "?");
+	(void) strcpy(fp->f_release, "?");
+
+	if ((f = fopen(path, "r")) == NULL) {
+		fprintf(stderr, "%s: unable to open %s\n", progname, path);
+		exit(1);
+	}
+	while (fgets(line, sizeof (line), f) != NULL) {
+		if (strncmp(line, "BENCHENV ", 9) == 0)
+			parse_env(fp, line + 9);
+		else if (strncmp(line, "BENCH ", 6) == 0)
+			parse_bench(fp, line + 6);
+	}
+	(void) fclose(f);
+
+	for (rp = fp->f_results; rp != NULL; rp = rp->r_next) {
+		for (i = 0; i < NSTATS; i++)
+			rp->r_stat[i] /= rp->r_runs;
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	rfile_t base, cmp;
+	result_t *bp, *cp;
+	char lbl[2][80];
+	int i, w = 4;
+
+	progname = argv[0];
+	if (argc != 3)
+		usage();
+
+	memset(&base, 0, sizeof (base));
+	memset(&cmp, 0, sizeof (cmp));
+	load(&base, argv[1]);
+	load(&cmp, argv[2]);
+
+	printf("baseline: %s (%s %s)\n", base.f_path, base.f_platform,
+	    base.f_release);
+	printf("compare:  %s (%s %s)\n\n", cmp.f_path, cmp.f_platform,
+	    cmp.f_release);
+
+	for (bp = base.f_results; bp != NULL; bp = bp->r_next) {
+		if ((int)strlen(bp->r_name) > w)
+			w = (int)strlen(bp->r_name);
+	}
+
+	printf("%-*s", w, "NAME");
+	for (i = 0; i < NSTATS; i++) {
+		(void) snprintf(lbl[0], sizeof (lbl[0]), "%s/%s",
+		    stat_keys[i], base.f_platform);
+		(void) snprintf(lbl[1], sizeof (lbl[1]), "%s/%s",
+		    stat_keys[i], cmp.f_platform);
+		printf(" %10s %10s %7s", lbl[0], lbl[1], "ratio");
+	}
+	putchar('\n');
+
+	for (bp = base.f_results; bp != NULL; bp = bp->r_next) {
+		printf("%-*s", w, bp->r_name);
+		if ((cp = find_result(&cmp, bp->r_name)) == NULL) {
+			printf(" missing from %s\n", cmp.f_path);
+			continue;
+		}
+		for (i = 0; i < NSTATS; i++) {
+			printf(" %10.0f %10.0f", bp->r_stat[i], cp->r_stat[i]);
+			if (bp->r_stat[i] > 0)
+				printf(" %6.2fx",
+				    cp->r_stat[i] / bp->r_stat[i]);
+			else
+				printf(" %7s", "-");
+		}
+		putchar('\n');
+	}
+
+	for (cp = cmp.f_results; cp != NULL; cp = cp->r_next) {
+		if (find_result(&base, cp->r_name) == NULL)
+			printf("%-*s missing from %s\n", w, cp->r_name,
+			    base.f_path);
+	}
+
+	return (0);
+}
@@ -0,0 +1,492 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Query a benchmark result store.
+ *
+ * Benchmarks append a record of each result, including its latency histogram,
+ * to the file named by LXTST_BENCH_STORE (see bench.c). Records are keyed by
+ * the platform build, the host and the benchmark name.
+ *
+ * 'benchstore list' shows the builds and hosts in a store and how many results
+ * each has.
+ *
+ * 'benchstore compare' compares the results for a build against those for a
+ * baseline build, for each benchmark run on the same host under both. The
+ * results of all runs of a benchmark under one build are pooled. For each
+ * benchmark it prints the chosen percentile under both builds, their ratio, and
+ * a bootstrap confidence interval for the ratio. A benchmark is flagged as
+ * SLOWER only if the whole interval lies above 1 + threshold, and as FASTER if
+ * it lies below 1 / (1 + threshold). The exit status is 1 if anything was
+ * SLOWER, so that this can be used as a gate.
+ *
+ * The samples within one run of a benchmark are not independent: two runs of
+ * the same build commonly differ by more than the spread within either run
+ * would suggest. So each resample first picks runs, with replacement, and then
+ * draws values from each picked run's histogram. A benchmark needs several
+ * runs under each build for the interval to account for this; if it has only
+ * one, the interval will be too narrow, and the result is marked with a '?'.
+ *
+ * To bound the run time, each resample draws at most MAX_DRAW values, or one
+ * from each run picked if there are more runs than that, rather than as many
+ * as the histograms hold. This can only widen the interval, so errs on the
+ * side of not flagging a change.
+ *
+ * If no build is given, the build of the last record in the store is used.
+ *
+ * usage: benchstore list store
+ *        benchstore compare [-B resamples] [-c confidence] [-p percentile]
+ *            [-t threshold] store baseline-build [build]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "lxbench.h"
+
+#define	DFLT_RESAMPLES	1000
+#define	DFLT_CONF	95.0		/* percent */
+#define	DFLT_PCT	50.0
+#define	DFLT_THRESHOLD	5.0		/* percent */
+#define	MAX_DRAW	5000
+#define	NFIELDS		10
+
+/* A histogram prepared for drawing random values from */
+typedef struct sampler {
+	int		s_nb;
+	int		*s_idx;		/* bucket index */
+	uint64_t	*s_cum;		/* cumulative count */
+} sampler_t;
+
+/* The results under one build: a histogram per run, and all runs pooled */
+typedef struct side {
+	int		sd_nruns;
+	sampler_t	*sd_runs;
+	bench_hist_t	*sd_pool;
+} side_t;
+
+typedef struct group {
+	char		*g_build;	/* for 'list' only */
+	char		*g_host;
+	char		*g_name;	/* for 'compare' only */
+	int		g_count;	/* for 'list' only */
+	side_t		g_side[2];	/* baseline and compared */
+	struct group	*g_next;
+} group_t;
+
+static char *progname;
+static group_t *groups;
+static group_t *groups_last;
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+static uint64_t draws[BENCH_NBUCKETS];
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s list store\n"
+	    "       %s compare [-B resamples] [-c confidence] "
+	    "[-p percentile]\n"
+	    "           [-t threshold] store baseline-build [build]\n",
+	    progname, progname);
+	exit(2);
+}
+
+static void
+fatal(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", progname, msg);
+	exit(1);
+}
+
+static char *
+xstrdup(const char *s)
+{
+	char *p;
+
+	if ((p = strdup(s)) == NULL)
+		fatal("out of memory");
+	return (p);
+}
+
+static int
+streq(const char *a, const char *b)
+{
+	return ((a == NULL && b == NULL) ||
+	    (a != NULL && b != NULL && strcmp(a, b) == 0));
+}
+
+static group_t *
+get_group(const char *build, const char *host, const char *name)
+{
+	group_t *gp;
+
+	for (gp = groups; gp != NULL; gp = gp->g_next) {
+		if (streq(gp->g_build, build) && streq(gp->g_host, host) &&
+		    streq(gp->g_name, name))
+			return (gp);
+	}
+
+	if ((gp = calloc(1, sizeof (group_t))) == NULL)
+		fatal("out of memory");
+	gp->g_build = build == NULL ? NULL : xstrdup(build);
+	gp->g_host = xstrdup(host);
+	gp->g_name = name == NULL ? NULL : xstrdup(name);
+	if (groups_last == NULL)
+		groups = gp;
+	else
+		groups_last->g_next = gp;
+	groups_last = gp;
+	return (gp);
+}
+
+/*
+ * Split a record into its fields. Returns 0 if the line isn't a record this
+ * version understands.
+ */
+static int
+split(char *line, char **f)
+{
+	char *lasts;
+	int i;
+
+	f[0] = strtok_r(line, " \n", &lasts);
+	for (i = 1; i < NFIELDS && f[i - 1] != NULL; i++)
+		f[i] = strtok_r(NULL, " \n", &lasts);
+	return (f[0] != NULL && strcmp(f[0], "1") == 0 &&
+	    f[NFIELDS - 1] != NULL);
+}
+
+/* Read the histogram from a record's fields. */
+static void
+read_hist(bench_hist_t *hp, char **f)
+{
+	char *tok, *lasts;
+	unsigned long long cnt;
+	int idx;
+
+	bench_hist_reset(hp);
+	hp->bh_count = strtoull(f[5], NULL, 10);
+	hp->bh_sum = strtoull(f[6], NULL, 10);
+	hp->bh_min = strtoull(f[7], NULL, 10);
+	hp->bh_max = strtoull(f[8], NULL, 10);
+	if (hp->bh_count == 0)
+		return;
+
+	for (tok = strtok_r(f[9], ",", &lasts); tok != NULL;
+	    tok = strtok_r(NULL, ",", &lasts)) {
+		if (sscanf(tok, "%d:%llu", &idx, &cnt) != 2 || idx < 0 ||
+		    idx >= BENCH_NBUCKETS)
+			fatal("malformed histogram in store");
+		hp->bh_buckets[idx] += cnt;
+	}
+}
+
+/*
+ * Read the store, calling 'fn' with the fields of each record. Returns the
+ * build of the last record.
+ */
+static char *
+scan(const char *path, void (*fn)(char **, void *), void *arg)
+{
+	FILE *fp;
+	char *line = NULL, *f[NFIELDS], *last = NULL;
+	size_t sz = 0;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		perror(path);
+		exit(1);
+	}
+	while (getline(&line, &sz, fp) >= 0) {
+		if (!split(line, f))
+			continue;
+		free(last);
+		last = xstrdup(f[1]);
+		if (fn != NULL)
+			fn(f, arg);
+	}
+	free(line);
+	(void) fclose(fp);
+
+	if (last == NULL)
+		fatal("no results in store");
+	return (last);
+}
+
+/* ARGSUSED */
+static void
+list_rec(char **f, void *arg)
+{
+	group_t *gp;
+
+	gp = get_group(f[1], f[2], NULL);
+	gp->g_count++;
+}
+
+static void
+do_list(int argc, char **argv)
+{
+	group_t *gp;
+
+	if (argc != 2)
+		usage();
+
+	(void) scan(argv[1], list_rec, NULL);
+	printf("%-40s %-20s %s\n", "BUILD", "HOST", "RESULTS");
+	for (gp = groups; gp != NULL; gp = gp->g_next)
+		printf("%-40s %-20s %d\n", gp->g_build, gp->g_host,
+		    gp->g_count);
+}
+
+/* xorshift64* */
+static uint64_t
+rng()
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (rng_state * 0x2545f4914f6cdd1dULL);
+}
+
+static void
+sampler_init(sampler_t *sp, const bench_hist_t *hp)
+{
+	uint64_t n = 0;
+	int i, nb = 0;
+
+	for (i = 0; i < BENCH_NBUCKETS; i++) {
+		if (hp->bh_buckets[i] != 0)
+			nb++;
+	}
+	if ((sp->s_idx = malloc(nb * sizeof (int))) == NULL ||
+	    (sp->s_cum = malloc(nb * sizeof (uint64_t))) == NULL)
+		fatal("out of memory");
+	sp->s_nb = nb;
+
+	nb = 0;
+	for (i = 0; i < BENCH_NBUCKETS; i++) {
+		if (hp->bh_buckets[i] == 0)
+			continue;
+		n += hp->bh_buckets[i];
+		sp->s_idx[nb] = i;
+		sp->s_cum[nb] = n;
+		nb++;
+	}
+}
+
+/* Add 'm' random values from the run's histogram to the draws */
+static void
+draw(sampler_t *sp, uint64_t m)
+{
+	uint64_t n = sp->s_cum[sp->s_nb - 1], r;
+	int lo, hi, mid;
+
+	while (m-- > 0) {
+		r = rng() % n;
+		lo = 0;
+		hi = sp->s_nb - 1;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (sp->s_cum[mid] > r)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		draws[sp->s_idx[lo]]++;
+	}
+}
+
+/*
+ * The given percentile of a random resample of the runs. If the runs picked
+ * have no values at all, it's the percentile of all of the side's runs.
+ */
+static double
+resample(side_t *sdp, double pct)
+{
+	uint64_t n = 0, m, rank, c = 0, per;
+	int i, k = sdp->sd_nruns, found = -1;
+	sampler_t *sp;
+
+	if ((per = MAX_DRAW / k) == 0)
+		per = 1;
+	for (i = 0; i < k; i++) {
+		sp = &sdp->sd_runs[rng() % k];
+		if (sp->s_nb == 0)
+			continue;
+		m = sp->s_cum[sp->s_nb - 1];
+		if (m > per)
+			m = per;
+		draw(sp, m);
+		n += m;
+	}
+
+	rank = (uint64_t)(pct / 100.0 * n + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < BENCH_NBUCKETS; i++) {
+		c += draws[i];
+		if (found < 0 && c >= rank)
+			found = i;
+		draws[i] = 0;
+	}
+	if (found < 0)
+		return ((double)bench_hist_pct(sdp->sd_pool, pct));
+	return ((double)bench_hist_value(found));
+}
+
+static void
+cmp_rec(char **f, void *arg)
+{
+	char **builds = arg;
+	bench_hist_t *hp;
+	side_t *sdp;
+	group_t *gp;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (strcmp(f[1], builds[i]) == 0)
+			break;
+	}
+	if (i == 2)
+		return;
+
+	hp = bench_hist_alloc();
+	read_hist(hp, f);
+	if (hp->bh_count == 0) {
+		bench_hist_free(hp);
+		return;
+	}
+
+	gp = get_group(NULL, f[2], f[3]);
+	sdp = &gp->g_side[i];
+	if (sdp->sd_pool == NULL)
+		sdp->sd_pool = bench_hist_alloc();
+	bench_hist_merge(sdp->sd_pool, hp);
+	if ((sdp->sd_runs = realloc(sdp->sd_runs,
+	    (sdp->sd_nruns + 1) * sizeof (sampler_t))) == NULL)
+		fatal("out of memory");
+	sampler_init(&sdp->sd_runs[sdp->sd_nruns++], hp);
+	bench_hist_free(hp);
+}
+
+static int
+dbl_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+static void
+do_compare(int argc, char **argv)
+{
+	int c, i, w = 4, nresamples = DFLT_RESAMPLES, slower = 0;
+	double conf = DFLT_CONF, pct = DFLT_PCT, thr = DFLT_THRESHOLD;
+	double *ratios, base, cur, lo, hi;
+	char *builds[2], plbl[32];
+	const char *verdict;
+	group_t *gp;
+
+	while ((c = getopt(argc, argv, "B:c:p:t:")) != -1) {
+		switch (c) {
+		case 'B':
+			nresamples = atoi(optarg);
+			break;
+		case 'c':
+			conf = atof(optarg);
+			break;
+		case 'p':
+			pct = atof(optarg);
+			break;
+		case 't':
+			thr = atof(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 2 || argc > 3 || nresamples < 10 || conf <= 0 ||
+	    conf >= 100 || pct <= 0 || pct > 100 || thr < 0)
+		usage();
+
+	builds[0] = argv[1];
+	builds[1] = argc == 3 ? argv[2] : scan(argv[0], NULL, NULL);
+	(void) scan(argv[0], cmp_rec, builds);
+
+	if ((ratios = malloc(nresamples * sizeof (double))) == NULL)
+		fatal("out of memory");
+
+	printf("baseline: %s\ncompare:  %s\n\n", builds[0], builds[1]);
+	for (gp = groups; gp != NULL; gp = gp->g_next) {
+		if ((int)strlen(gp->g_name) > w)
+			w = (int)strlen(gp->g_name);
+	}
+	(void) snprintf(plbl, sizeof (plbl), "p%g", pct);
+	printf("%-*s %-16s %10s %10s %7s %17s\n", w, "NAME", "HOST", plbl, plbl,
+	    "ratio", "confidence");
+
+	for (gp = groups; gp != NULL; gp = gp->g_next) {
+		printf("%-*s %-16s ", w, gp->g_name, gp->g_host);
+		if (gp->g_side[0].sd_nruns == 0) {
+			printf("no baseline\n");
+			continue;
+		}
+		if (gp->g_side[1].sd_nruns == 0) {
+			printf("not run\n");
+			continue;
+		}
+
+		base = (double)bench_hist_pct(gp->g_side[0].sd_pool, pct);
+		cur = (double)bench_hist_pct(gp->g_side[1].sd_pool, pct);
+
+		for (i = 0; i < nresamples; i++) {
+			ratios[i] = resample(&gp->g_side[1], pct) /
+			    (resample(&gp->g_side[0], pct) + 1e-9);
+		}
+
+		qsort(ratios, nresamples, sizeof (double), dbl_cmp);
+		lo = ratios[(int)(nresamples * (100.0 - conf) / 200.0)];
+		hi = ratios[(int)(nresamples * (100.0 + conf) / 200.0) - 1];
+
+		if (lo > 1.0 + thr / 100.0) {
+			verdict = "SLOWER";
+			slower++;
+		} else if (hi < 1.0 / (1.0 + thr / 100.0)) {
+			verdict = "FASTER";
+		} else {
+			verdict = "";
+		}
+		printf("%10.0f %10.0f %6.2fx [%6.2f, %6.2f]%s %s\n", base, cur,
+		    base > 0 ? cur / base : 0.0, lo, hi,
+		    gp->g_side[0].sd_nruns < 2 || gp->g_side[1].sd_nruns < 2 ?
+		    "?" : " ", verdict);
+	}
+
+	exit(slower != 0 ? 1 : 0);
+}
+
+int
+main(int argc, char **argv)
+{
+	progname = argv[0];
+	if (argc < 2)
+		usage();
+
+	if (strcmp(argv[1], "list") == 0)
+		do_list(argc - 1, argv + 1);
+	else if (strcmp(argv[1], "compare") == 0)
+		do_compare(argc - 1, argv + 1);
+	else
+		usage();
+	return (0);
+}
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2016, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 
@@ -62,6 +62,8 @@
 #define	CLONE_IO	0x80000000
 #endif
 
+/* eventfd used by the processes of a test to signal each other */
+static int efd;
 
 static int
 c1(void *a)
@@ -77,16 +79,15 @@ c1(void *a)
 static int
 c2(void *a)
 {
-	int i;
 	char buf[256];
 
-	/* keep checking until parent changes our cwd and umask */
-	for (i = 0; i < 10000; i++) {
-		getcwd(buf, sizeof (buf));
-		if (strcmp(buf, "/tmp") == 0 && umask(0777) == 0751) {
-			exit (0);
-		}
-		usleep(1000);
+	/* wait until parent changes our cwd and umask */
+	if (rdv_efd_wait(efd) != 0)
+		exit (1);
+
+	getcwd(buf, sizeof (buf));
+	if (strcmp(buf, "/tmp") == 0 && umask(0777) == 0751) {
+		exit (0);
 	}
 
 	exit (1);
@@ -99,22 +100,22 @@ c1a(void *a)
 		perror("child chdir failed\n");
 		exit(1);
 	}
+	(void) rdv_efd_post(efd);
 	exit(0);
 }
 
 static int
 c2a(void *a)
 {
-	int i;
 	char buf[256];
 
-	/* keep checking until sibling changes our cwd */
-	for (i = 0; i < 10000; i++) {
-		getcwd(buf, sizeof (buf));
-		if (strcmp(buf, "/tmp") == 0) {
-			exit (0);
-		}
-		usleep(1000);
+	/* wait until sibling changes our cwd */
+	if (rdv_efd_wait(efd) != 0)
+		exit (1);
+
+	getcwd(buf, sizeof (buf));
+	if (strcmp(buf, "/tmp") == 0) {
+		exit (0);
 	}
 
 	exit (1);
@@ -263,7 +264,7 @@ test4()
 static int
 test5()
 {
-	int stat, i;
+	int stat;
 	char buf[256];
 	char *stack, *top;
 
@@ -278,24 +279,22 @@ test5()
 		return (3);
 	umask(0777);
 
+	if ((efd = rdv_efd()) < 0)
+		return (1);
 	if (clone(c2, top, CLONE_FS | SIGCHLD, NULL, NULL, NULL, NULL) < 0)
 		return (4);
 
-	for (i = 0; i < 10000; i++) {
-		if (chdir("/tmp") != 0) {
-			return (5);
-		}
-		umask(0751);
-
-		if (waitpid(-1, &stat, WNOHANG) > 0) {
-			if (WEXITSTATUS(stat) != 0)
-				return (6);
-			break;
-		}
-		usleep(1000);
+	if (chdir("/tmp") != 0) {
+		return (5);
 	}
-	if (i == 10000)
+	umask(0751);
+	(void) rdv_efd_post(efd);
+
+	if (waitpid(-1, &stat, 0) < 0)
 		return (7);
+	close(efd);
+	if (WEXITSTATUS(stat) != 0)
+		return (6);
 
 	return (0);
 }
@@ -333,7 +332,7 @@ test6()
 	for (i = 0; i < 500; i++) {
 		pid = fork();
 		if (pid < 0) {
-			printf("FAIL clone 6, fork failed\n");
+			(void) test_case_fail("clone", 6, "fork failed");
 			exit(1);
 		}
 
@@ -344,6 +343,10 @@ test6()
 		}
 	}
 
+	/* reap the workers rather than leave them for init */
+	while (wait(NULL) > 0)
+		;
+
 	return (0);
 }
 
@@ -353,7 +356,7 @@ test6()
 static int
 test7()
 {
-	int stat, i, found;
+	int stat, found;
 	char buf[256];
 	char *s1, *t1;
 	char *s2, *t2;
@@ -372,25 +375,20 @@ test7()
 	if (strcmp(buf, "/") != 0)
 		return (3);
 
+	if ((efd = rdv_efd()) < 0)
+		return (1);
 	if (clone(c2a, t1, CLONE_FS | SIGCHLD, NULL, NULL, NULL, NULL) < 0)
 		return (4);
-	usleep(1000);
 	if (clone(c1a, t2, CLONE_FS | SIGCHLD, NULL, NULL, NULL, NULL) < 0)
 		return (5);
 
-	found = 0;
-	for (i = 0; i < 10000; i++) {
-		if (waitpid(-1, &stat, WNOHANG) > 0) {
-			if (WEXITSTATUS(stat) != 0)
-				return (6);
-			found++;
-			if (found == 2)
-				break;
-		}
-		usleep(1000);
+	for (found = 0; found < 2; found++) {
+		if (waitpid(-1, &stat, 0) < 0)
+			return (7);
+		if (WEXITSTATUS(stat) != 0)
+			return (6);
 	}
-	if (i == 10000)
-		return (7);
+	close(efd);
 
 	/* child should have changed our cwd */
 	getcwd(buf, sizeof (buf));
@@ -476,7 +474,7 @@ test9()
 	for (i = 0; i < 500; i++) {
 		pid = fork();
 		if (pid < 0) {
-			printf("FAIL clone 6, fork failed\n");
+			(void) test_case_fail("clone", 9, "fork failed");
 			exit(1);
 		}
 
@@ -683,10 +681,15 @@ run(int tstcase, int (*tc)())
 	int pid;
 	int status;
 	int res;
+	char e[80];
+
+	if (!test_selected(tstcase))
+		return (0);
 
+	(void) test_case("clone", tstcase);
 	pid = fork();
 	if (pid < 0) {
-		printf("FAIL clone %d, initial fork failed\n", tstcase);
+		(void) test_case_fail("clone", tstcase, "initial fork failed");
 		exit(1);
 	}
 
@@ -699,7 +702,8 @@ run(int tstcase, int (*tc)())
 	waitpid(pid, &status, 0);
 	if (WEXITSTATUS(status) == 0)
 		return (0);
-	printf("FAIL clone %d, status: %d\n", tstcase, WEXITSTATUS(status));
+	snprintf(e, sizeof (e), "exit status %d", WEXITSTATUS(status));
+	(void) test_case_fail("clone", tstcase, e);
 	exit(1);
 }
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2016, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 /*
@@ -34,8 +34,8 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 
-pthread_mutexattr_t attr;
-pthread_mutex_t m;
+static pthread_mutexattr_t attr;
+static pthread_mutex_t m;
 
 static int val;
 
@@ -43,15 +43,15 @@ static int val;
 static int c_cnt, p_cnt;
 
 /*
- * This is used for a shared state machine, along with a nanosleep, to ensure
- * the two threads are the expected state for the specific test case.
+ * This is used for a shared state machine, stepped through with the rendezvous
+ * functions, to ensure the two threads are the expected state for the specific
+ * test case.
  */
-static int state;
+static volatile int state;
 
 static int chld_id;
 static int par_id;
 static int tc;
-static struct timespec ts;
 static pthread_t tid;
 
 static int
@@ -63,7 +63,7 @@ futex(int *uaddr, int futex_op, const struct timespec *timeout)
 static int
 tfail(char *msg)
 {
-	printf("FAIL futex %d: %s\n", tc, msg);
+	(void) test_case_fail("futex", tc, msg);
 	exit(1);
 }
 
@@ -74,11 +74,37 @@ advance_state(int expect)
 
 	if (state != expect) {
 		snprintf(buf, sizeof (buf), "state out of sync, "
-		   "expected %d, got %d", 0, state);
+		   "expected %d, got %d", expect, state);
 		tfail(buf);
 	}
 
-	state++;
+	rdv_set(&state, expect + 1);
+}
+
+/* Wait for the other thread to advance the state to at least 'want' */
+static void
+wait_state(int want)
+{
+	char buf[80];
+
+	if (rdv_wait_ge(&state, want) != 0) {
+		snprintf(buf, sizeof (buf), "timed out waiting for state %d, "
+		    "at %d", want, state);
+		tfail(buf);
+	}
+}
+
+/* Wait for the parent to block, e.g. on the mutex we hold */
+static void
+wait_par_blocked()
+{
+	char buf[80];
+
+	if (rdv_blocked(par_id) != 0) {
+		snprintf(buf, sizeof (buf), "parent did not block, errno %d",
+		    errno);
+		tfail(buf);
+	}
 }
 
 static void
@@ -86,27 +112,19 @@ thr1()
 {
 	char buf[80];
 	int *pm = (int *)&m;
-	int i;
 
 	chld_id = syscall(SYS_gettid);
-	advance_state(0);
-
 	errno = 0;
 	if (pthread_mutex_lock(&m) != 0) {
 		snprintf(buf, sizeof (buf), "lock errno %d", errno);
 		tfail(buf);
 	}
 
-	while (state == 1)
-		nanosleep(&ts, NULL);
-
-	for (i = 0; i < 10; i++) {
-		if (*pm == (chld_id | FUTEX_WAITERS))
-			break;
-		nanosleep(&ts, NULL);
-	}
+	advance_state(0);
+	wait_state(2);
+	wait_par_blocked();
 
-	if (i == 10 && *pm != (chld_id | FUTEX_WAITERS)) {
+	if (*pm != (chld_id | FUTEX_WAITERS)) {
 		snprintf(buf, sizeof (buf), "expected (b) 0x%x, got 0x%x",
 		    chld_id | FUTEX_WAITERS, *pm);
 		tfail(buf);
@@ -172,13 +190,12 @@ thr_hold_exit()
 }
 
 /*
- * Take a mutex and hold it for a second before releasing it.
+ * Take a mutex and hold it until the parent is done trying to get it.
  */
 static void
 thr4()
 {
 	char buf[80];
-	struct timespec csleep;
 
 	chld_id = syscall(SYS_gettid);
 	errno = 0;
@@ -187,11 +204,8 @@ thr4()
 		tfail(buf);
 	}
 
-	csleep.tv_sec = 1;
-	csleep.tv_nsec = 0;
-
 	advance_state(0);
-	nanosleep(&csleep, NULL);
+	wait_state(2);
 
 	errno = 0;
 	if (pthread_mutex_unlock(&m) != 0 && errno != 0) {
@@ -209,7 +223,6 @@ thr6()
 {
 	char buf[80];
 	int *pm = (int *)&m;
-	int i;
 
 	chld_id = syscall(SYS_gettid);
 	errno = 0;
@@ -227,17 +240,12 @@ thr6()
 	advance_state(0);
 
 	/* Wait for parent to be ready to queue on the mutex */
-	while (state == 1)
-		nanosleep(&ts, NULL);
+	wait_state(2);
 
 	/* Wait for parent to enqueue */
-	for (i = 0; i < 10; i++) {
-		if (*pm == (chld_id | FUTEX_WAITERS))
-			break;
-		nanosleep(&ts, NULL);
-	}
+	wait_par_blocked();
 
-	if (i == 10 && *pm != (chld_id | FUTEX_WAITERS)) {
+	if (*pm != (chld_id | FUTEX_WAITERS)) {
 		snprintf(buf, sizeof (buf), "expected (b) 0x%x, got 0x%x",
 		    chld_id | FUTEX_WAITERS, *pm);
 		tfail(buf);
@@ -302,7 +310,7 @@ test0()
 {
 	char buf[80];
 
-	tc = 0;
+	tc = test_case("futex", 0);
 	if (futex((int *)5000, FUTEX_LOCK_PI_PRIVATE, NULL) == 0 ||
 	    errno != EFAULT) {
 		snprintf(buf, sizeof (buf), "lock errno %d", errno);
@@ -325,7 +333,7 @@ test1()
 	char buf[80];
 	int *pm = (int *)&m;
 
-	tc = 1;
+	tc = test_case("futex", 1);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -338,8 +346,7 @@ test1()
 
 	pthread_create(&tid, NULL, (void *(*)(void *))thr1, (void *)NULL);
 
-	while (state == 0)
-		nanosleep(&ts, NULL);
+	wait_state(1);
 
 	if (*pm != chld_id) {
 		snprintf(buf, sizeof (buf), "expected (a) 0x%x, got 0x%x",
@@ -355,8 +362,7 @@ test1()
 		tfail(buf);
 	}
 
-	while (state < 3)
-		nanosleep(&ts, NULL);
+	wait_state(3);
 
 	if (*pm != (par_id | FUTEX_WAITERS)) {
 		snprintf(buf, sizeof (buf), "expected (c) 0x%x, got 0x%x",
@@ -394,7 +400,7 @@ test2()
 	char buf[80];
 	int *pm = (int *)&m;
 
-	tc = 2;
+	tc = test_case("futex", 2);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -410,8 +416,7 @@ test2()
 
 	pthread_create(&tid, NULL, (void *(*)(void *))thr2, (void *)NULL);
 
-	while (state < 1)
-		nanosleep(&ts, NULL);
+	wait_state(1);
 
 	/* wait for child to exit while holding the mutex */
 	pthread_join(tid, NULL);
@@ -463,7 +468,7 @@ test3()
 	char buf[80];
 	int *pm = (int *)&m;
 
-	tc = 3;
+	tc = test_case("futex", 3);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -477,8 +482,7 @@ test3()
 	pthread_create(&tid, NULL, (void *(*)(void *))thr_hold_exit,
 	    (void *)NULL);
 
-	while (state < 1)
-		nanosleep(&ts, NULL);
+	wait_state(1);
 
 	/* wait for child to exit while holding the mutex */
 	pthread_join(tid, NULL);
@@ -502,7 +506,7 @@ test4()
 	int *pm = (int *)&m;
 	int r;
 
-	tc = 4;
+	tc = test_case("futex", 4);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -515,8 +519,7 @@ test4()
 
 	pthread_create(&tid, NULL, (void *(*)(void *))thr4, (void *)NULL);
 
-	while (state < 1)
-		nanosleep(&ts, NULL);
+	wait_state(1);
 
 	if (*pm != chld_id) {
 		snprintf(buf, sizeof (buf), "expected (a) 0x%x, got 0x%x",
@@ -538,6 +541,10 @@ test4()
 		tfail(buf);
 	}
 
+	/* Let the child release the mutex */
+	advance_state(1);
+	pthread_join(tid, NULL);
+
 	return (0);
 }
 
@@ -550,7 +557,7 @@ test5()
 	char buf[80];
 	int *pm = (int *)&m;
 
-	tc = 5;
+	tc = test_case("futex", 5);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -567,8 +574,7 @@ test5()
 	pthread_create(&tid, NULL, (void *(*)(void *))thr_hold_exit,
 	    (void *)NULL);
 
-	while (state < 1)
-		nanosleep(&ts, NULL);
+	wait_state(1);
 
 	/* wait for child to exit while holding the mutex */
 	pthread_join(tid, NULL);
@@ -604,7 +610,7 @@ test6()
 	char buf[80];
 	int *pm = (int *)&m;
 
-	tc = 6;
+	tc = test_case("futex", 6);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -621,8 +627,7 @@ test6()
 	pthread_create(&tid, NULL, (void *(*)(void *))thr6, (void *)NULL);
 
 	/* Wait for child to take the mutex */
-	while (state < 1)
-		nanosleep(&ts, NULL);
+	wait_state(1);
 
 	/* Tell child to proceed - i.e. exit */
 	advance_state(1);
@@ -657,7 +662,7 @@ test7()
 	char buf[80];
 	int *pm = (int *)&m;
 
-	tc = 7;
+	tc = test_case("futex", 7);
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
 		tfail("pthread_mutexattr_init");
@@ -702,7 +707,7 @@ test7()
 static int
 test_balance()
 {
-	tc = 99;
+	tc = test_case("futex", 99);
 	c_cnt = p_cnt = 0;
 	state = 0;
 	if (pthread_mutexattr_init(&attr) != 0)
@@ -718,25 +723,32 @@ test_balance()
 	    (void *)NULL);
 
 	worker_balance(0);
+	pthread_join(tid, NULL);
 	return (0);
 }
 
 int
 main(int argc, char **argv)
 {
-	ts.tv_sec = 0;
-	ts.tv_nsec = 1000000;
-
 	par_id = syscall(SYS_gettid);
 
-	test0();
-	test1();
-	test2();
-	test3();
-	test4();
-	test5();
-	test6();
-	test7();
-	test_balance();
+	if (test_selected(0))
+		test0();
+	if (test_selected(1))
+		test1();
+	if (test_selected(2))
+		test2();
+	if (test_selected(3))
+		test3();
+	if (test_selected(4))
+		test4();
+	if (test_selected(5))
+		test5();
+	if (test_selected(6))
+		test6();
+	if (test_selected(7))
+		test7();
+	if (test_selected(99))
+		test_balance();
 	return (test_pass("futex"));
 }
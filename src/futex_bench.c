@@ -0,0 +1,127 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Benchmark the cost of the futex(2) operations which the futex test covers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "lxbench.h"
+
+static int fword;
+static volatile int pp_state;
+
+#define	PP_PING	1
+#define	PP_PONG	2
+#define	PP_EXIT	3
+
+static int
+futex(int *uaddr, int op, int val)
+{
+	return (syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0));
+}
+
+/* FUTEX_WAKE with nobody waiting */
+/* ARGSUSED */
+static void
+b_wake(void *arg, uint64_t n)
+{
+	while (n-- > 0)
+		(void) futex(&fword, FUTEX_WAKE_PRIVATE, 1);
+}
+
+/* FUTEX_WAIT which returns EAGAIN since the value doesn't match */
+/* ARGSUSED */
+static void
+b_wait_mismatch(void *arg, uint64_t n)
+{
+	while (n-- > 0)
+		(void) futex(&fword, FUTEX_WAIT_PRIVATE, 1);
+}
+
+/* Uncontended FUTEX_LOCK_PI followed by FUTEX_UNLOCK_PI */
+/* ARGSUSED */
+static void
+b_lock_pi(void *arg, uint64_t n)
+{
+	while (n-- > 0) {
+		(void) futex(&fword, FUTEX_LOCK_PI_PRIVATE, 0);
+		(void) futex(&fword, FUTEX_UNLOCK_PI_PRIVATE, 0);
+	}
+}
+
+/* ARGSUSED */
+static void *
+pong(void *arg)
+{
+	int s;
+
+	for (;;) {
+		while ((s = pp_state) != PP_PING) {
+			if (s == PP_EXIT)
+				return (NULL);
+			(void) futex((int *)&pp_state, FUTEX_WAIT_PRIVATE, s);
+		}
+		pp_state = PP_PONG;
+		(void) futex((int *)&pp_state, FUTEX_WAKE_PRIVATE, 1);
+	}
+}
+
+/* A wake and wait round trip between two threads */
+/* ARGSUSED */
+static void
+b_pingpong(void *arg, uint64_t n)
+{
+	while (n-- > 0) {
+		pp_state = PP_PING;
+		(void) futex((int *)&pp_state, FUTEX_WAKE_PRIVATE, 1);
+		while (pp_state == PP_PING)
+			(void) futex((int *)&pp_state, FUTEX_WAIT_PRIVATE,
+			    PP_PING);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	pthread_t tid;
+
+	bench_init();
+
+	if (bench_selected(argc, argv, "futex.wake_nowaiters"))
+		bench_run("futex.wake_nowaiters", b_wake, NULL);
+
+	if (bench_selected(argc, argv, "futex.wait_mismatch"))
+		bench_run("futex.wait_mismatch", b_wait_mismatch, NULL);
+
+	if (bench_selected(argc, argv, "futex.lock_unlock_pi")) {
+		fword = 0;
+		bench_run("futex.lock_unlock_pi", b_lock_pi, NULL);
+		fword = 0;
+	}
+
+	if (bench_selected(argc, argv, "futex.pingpong")) {
+		if (pthread_create(&tid, NULL, pong, NULL) != 0)
+			bench_fail("futex.pingpong", "pthread_create failed");
+		bench_run("futex.pingpong", b_pingpong, NULL);
+		pp_state = PP_EXIT;
+		(void) futex((int *)&pp_state, FUTEX_WAKE_PRIVATE, INT_MAX);
+		(void) pthread_join(tid, NULL);
+	}
+
+	return (0);
+}
@@ -0,0 +1,122 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Loopback TCP sockets for tests.
+ *
+ * Listeners are bound to port 0 on 127.0.0.1 so that the system picks a free
+ * port, which lets tests that use sockets run at the same time as each other.
+ * A listener is ready for connections as soon as loopback_listen() returns, so
+ * a client can connect without waiting for the server side to get going, and
+ * one listener can be used to make any number of connections.
+ *
+ * These return -1 with errno set on failure.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "lxtst.h"
+
+static void
+loopback_addr(struct sockaddr_in *ap, int port)
+{
+	memset(ap, 0, sizeof (*ap));
+	ap->sin_family = AF_INET;
+	ap->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ap->sin_port = htons(port);
+}
+
+/* Returns a listening socket, and the port it is bound to in *portp. */
+int
+loopback_listen(int *portp)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof (addr);
+	int fd, err;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return (-1);
+
+	loopback_addr(&addr, 0);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof (addr)) < 0 ||
+	    listen(fd, SOMAXCONN) < 0 ||
+	    getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+		err = errno;
+		(void) close(fd);
+		errno = err;
+		return (-1);
+	}
+
+	*portp = ntohs(addr.sin_port);
+	return (fd);
+}
+
+/* Returns a socket connected to the listener on the given port. */
+int
+loopback_connect(int port)
+{
+	struct sockaddr_in addr;
+	int fd, err;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return (-1);
+
+	loopback_addr(&addr, port);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof (addr)) < 0) {
+		err = errno;
+		(void) close(fd);
+		errno = err;
+		return (-1);
+	}
+	return (fd);
+}
+
+/*
+ * Make a connected pair of sockets through the given listener: fds[0] is the
+ * client end and fds[1] the server end. If 'lfd' is -1, a listener is made for
+ * just this connection.
+ */
+int
+loopback_pair(int lfd, int fds[2])
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof (addr);
+	int port, tmp = -1, err;
+
+	if (lfd < 0) {
+		if ((tmp = lfd = loopback_listen(&port)) < 0)
+			return (-1);
+	} else if (getsockname(lfd, (struct sockaddr *)&addr, &len) < 0) {
+		return (-1);
+	} else {
+		port = ntohs(addr.sin_port);
+	}
+
+	/* The connection completes in the backlog, before it's accepted. */
+	fds[1] = -1;
+	if ((fds[0] = loopback_connect(port)) < 0 ||
+	    (fds[1] = accept(lfd, NULL, NULL)) < 0) {
+		err = errno;
+		if (fds[0] >= 0)
+			(void) close(fds[0]);
+		if (tmp >= 0)
+			(void) close(tmp);
+		errno = err;
+		return (-1);
+	}
+
+	if (tmp >= 0)
+		(void) close(tmp);
+	return (0);
+}
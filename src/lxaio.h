@@ -0,0 +1,64 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+#ifndef _LXAIO_H
+#define _LXAIO_H
+
+#include <stddef.h>
+#include <time.h>
+#include <signal.h>
+#include <linux/aio_abi.h>
+
+/*
+ * The Linux native aio syscalls, which libc doesn't provide wrappers for; see
+ * aio_subr.c. These return -1 with errno set on failure.
+ */
+int io_setup(int, aio_context_t *);
+int io_submit(aio_context_t, long, struct iocb *[]);
+int io_getevents(aio_context_t, long, long, struct io_event *,
+    struct timespec *);
+int io_cancel(aio_context_t, struct iocb *, struct io_event *);
+int io_destroy(aio_context_t);
+
+/*
+ * io_getevents() with the signal mask replaced by the given one while it
+ * waits, as ppoll() does; a NULL mask leaves the mask alone.
+ */
+int io_pgetevents(aio_context_t, long, long, struct io_event *,
+    struct timespec *, const sigset_t *);
+
+/*
+ * A pool of iocbs, each with its own buffer, all carved out of one mapping
+ * made up front, so that iocbs can be handed out and recycled across
+ * io_submit() rounds without going near the allocator. Buffers are aligned
+ * for O_DIRECT. aio_pool_create() returns NULL with errno set on failure, and
+ * aio_pool_get() returns NULL if every iocb is in use. See aio_subr.c.
+ */
+typedef struct aio_pool aio_pool_t;
+
+#define	AIO_POOL_HUGE	0x01	/* try to back the pool with huge pages */
+
+aio_pool_t *aio_pool_create(int, size_t, int);
+void aio_pool_destroy(aio_pool_t *);
+struct iocb *aio_pool_get(aio_pool_t *);
+void aio_pool_put(aio_pool_t *, struct iocb *);
+int aio_pool_slot(aio_pool_t *, struct iocb *);
+
+/*
+ * Reaping completions straight from the ring which Linux maps at the address
+ * of the context, as libaio and fio do, rather than with io_getevents(). See
+ * aio_subr.c.
+ */
+int aio_ring_usable(aio_context_t);
+int aio_ring_reap(aio_context_t, long, struct io_event *);
+int aio_ring_getevents(aio_context_t, long, long, struct io_event *,
+    struct timespec *);
+
+#endif /* _LXAIO_H */
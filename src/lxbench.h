@@ -0,0 +1,86 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+#ifndef _LXBENCH_H
+#define _LXBENCH_H
+
+#include <stdint.h>
+
+/*
+ * Latency histogram. Values below BENCH_SUB are recorded exactly; above that,
+ * each power of two is split into BENCH_SUB / 2 linear buckets, which keeps
+ * the error of any reported value under 1%.
+ */
+#define	BENCH_SUB_BITS	8
+#define	BENCH_SUB	(1 << BENCH_SUB_BITS)
+#define	BENCH_NBUCKETS	(BENCH_SUB + (64 - BENCH_SUB_BITS) * (BENCH_SUB / 2))
+
+typedef struct bench_hist {
+	uint64_t	bh_count;
+	uint64_t	bh_sum;
+	uint64_t	bh_min;
+	uint64_t	bh_max;
+	uint64_t	bh_buckets[BENCH_NBUCKETS];
+} bench_hist_t;
+
+bench_hist_t *bench_hist_alloc(void);
+void bench_hist_free(bench_hist_t *);
+void bench_hist_reset(bench_hist_t *);
+void bench_hist_record(bench_hist_t *, uint64_t);
+void bench_hist_merge(bench_hist_t *, const bench_hist_t *);
+uint64_t bench_hist_pct(const bench_hist_t *, double);
+uint64_t bench_hist_mean(const bench_hist_t *);
+int bench_hist_index(uint64_t);
+uint64_t bench_hist_value(int);
+
+/* Monotonic time in nanoseconds */
+uint64_t bench_now(void);
+
+/*
+ * Set up for benchmarking: read the LXTST_BENCH_* settings, pin to a CPU if
+ * asked to, and print the BENCHENV line describing where we're running.
+ */
+void bench_init(void);
+
+/* Settings, in nanoseconds */
+uint64_t bench_runtime(void);
+uint64_t bench_warmup(void);
+
+/* Pin the calling thread to a CPU */
+int bench_pin(int);
+
+/*
+ * True if the named benchmark should run; i.e. no names were given on the
+ * command line, or one of them is a prefix of 'name'.
+ */
+int bench_selected(int, char **, const char *);
+
+/*
+ * Run a closed-loop benchmark. The function is called with its argument and
+ * an iteration count, and must perform the operation being measured that many
+ * times. The count is calibrated so that each timed sample is long enough to
+ * swamp the cost of reading the clock; the per-operation time of each sample
+ * is recorded.
+ */
+typedef void (*bench_func_t)(void *, uint64_t);
+void bench_run(const char *, bench_func_t, void *);
+
+/*
+ * Print a result line for the histogram, followed by any number of extra
+ * (const char *key, double value) pairs terminated by a NULL key.
+ */
+void bench_report(const char *, const bench_hist_t *, ...);
+
+void bench_fail(const char *, const char *);
+
+/* Report that a benchmark can't be run here, e.g. for lack of a feature */
+void bench_skip(const char *, const char *);
+
+#endif /* _LXBENCH_H */
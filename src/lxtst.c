@@ -0,0 +1,182 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Multi-call test binary.
+ *
+ * 'make lxtst' builds each of the tests in MULTI_TESTS with its main()
+ * renamed to <test>_main() and links them all into this one binary, so that a
+ * test can be run over and over without paying for an exec and dynamic
+ * linking each time.
+ *
+ * usage: lxtst [-f] [-n count] [-c cases] test [arg...]
+ *        lxtst -l
+ *
+ * The test is run 'count' times, by default in this process. Since a test's
+ * global state is not reset between runs, only the tests marked re-entrant in
+ * MULTI_TESTS are run this way; the others, and every test when -f is given,
+ * are run in a fresh forked copy of this process each time. A re-entrant test
+ * which calls exit() still ends the loop. -c sets LXTST_CASES, which selects
+ * the numbered cases to run in tests which support that. -l lists the tests.
+ *
+ * If this binary is invoked under the name of a test, e.g. through a link
+ * named 'futex', that test is run once with the given arguments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "lxtst.h"
+
+#ifndef MULTI_TESTS
+#error "MULTI_TESTS must list the tests, as X(test, reentrant) ..."
+#endif
+
+typedef struct mtest {
+	const char	*mt_name;
+	int		(*mt_main)(int, char **);
+	int		mt_reentrant;
+} mtest_t;
+
+#define	X(t, r)	extern int t##_main(int, char **);
+MULTI_TESTS
+#undef X
+
+static mtest_t mtests[] = {
+#define	X(t, r)	{ #t, t##_main, r },
+MULTI_TESTS
+#undef X
+	{ NULL, NULL, 0 }
+};
+
+static char *progname;
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s [-f] [-n count] [-c cases] test [arg...]\n"
+	    "       %s -l\n", progname, progname);
+	exit(2);
+}
+
+static mtest_t *
+lookup(const char *name)
+{
+	mtest_t *mp;
+
+	for (mp = mtests; mp->mt_name != NULL; mp++) {
+		if (strcmp(mp->mt_name, name) == 0)
+			return (mp);
+	}
+	return (NULL);
+}
+
+static int
+run_forked(mtest_t *mp, int argc, char **argv)
+{
+	pid_t pid;
+	int status;
+
+	(void) fflush(stdout);
+	if ((pid = fork()) < 0) {
+		perror("fork");
+		return (1);
+	}
+	if (pid == 0) {
+		test_reset();
+		exit(mp->mt_main(argc, argv));
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		return (1);
+	}
+	if (WIFSIGNALED(status)) {
+		printf("FAIL %s: killed by signal %d\n", mp->mt_name,
+		    WTERMSIG(status));
+		return (1);
+	}
+	return (WEXITSTATUS(status));
+}
+
+int
+main(int argc, char **argv)
+{
+	mtest_t *mp;
+	char *base;
+	int c, i, count = 1, forked = 0, failed = 0;
+	struct timespec start, end;
+	double wall;
+
+	progname = argv[0];
+	base = strrchr(argv[0], '/');
+	base = base == NULL ? argv[0] : base + 1;
+	if ((mp = lookup(base)) != NULL)
+		return (mp->mt_main(argc, argv));
+
+	while ((c = getopt(argc, argv, "+c:fln:")) != -1) {
+		switch (c) {
+		case 'c':
+			if (setenv("LXTST_CASES", optarg, 1) != 0) {
+				perror("setenv");
+				return (1);
+			}
+			break;
+		case 'f':
+			forked = 1;
+			break;
+		case 'l':
+			for (mp = mtests; mp->mt_name != NULL; mp++)
+				printf("%s\n", mp->mt_name);
+			return (0);
+		case 'n':
+			if ((count = atoi(optarg)) < 1)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 1)
+		usage();
+
+	if ((mp = lookup(argv[0])) == NULL) {
+		fprintf(stderr, "%s: unknown test: %s\n", progname, argv[0]);
+		return (2);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		if (forked || !mp->mt_reentrant) {
+			if (run_forked(mp, argc, argv) != 0)
+				failed++;
+		} else {
+			test_reset();
+			if (mp->mt_main(argc, argv) != 0)
+				failed++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (count > 1) {
+		wall = (end.tv_sec - start.tv_sec) +
+		    (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("TIME %s: %d runs, %d failed, wall %.3fs, %.3fms/run\n",
+		    mp->mt_name, count, failed, wall, wall * 1000.0 / count);
+	}
+
+	return (failed != 0);
+}
@@ -5,14 +5,57 @@
  */
 
 /*
- * Copyright (c) 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #ifndef _LXTST_H
 #define _LXTST_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 int test_pass(const char *);
 int test_fail(const char *, const char *);
 int test_skip(const char *, const char *);
 
+/*
+ * Numbered test cases. test_case() marks the start of case 'tc' and returns
+ * 'tc'; test_case_fail() reports that a case failed.
+ */
+int test_case(const char *, int);
+int test_case_fail(const char *, int, const char *);
+
+/* Should numbered case 'tc' run, according to LXTST_CASES? */
+int test_selected(int);
+
+/* Reset result reporting before the multi-call binary (re)runs a test. */
+void test_reset(void);
+
+/*
+ * Loopback TCP sockets on a port chosen by the system; see loopback.c.
+ */
+int loopback_listen(int *);
+int loopback_connect(int);
+int loopback_pair(int, int [2]);
+
+/*
+ * Rendezvous between threads and processes; see rendezvous.c.
+ */
+int rdv_wait_ne(volatile int *, int);
+int rdv_wait_ge(volatile int *, int);
+void rdv_set(volatile int *, int);
+int rdv_blocked(int);
+int rdv_efd(void);
+int rdv_efd_post(int);
+int rdv_efd_wait(int);
+
+/*
+ * Checking test data without running diff; see verify.c.
+ */
+uint32_t crc32c(uint32_t, const void *, size_t);
+void pattern_fill(void *, size_t, uint64_t);
+uint32_t pattern_crc(size_t, uint64_t);
+int pattern_check(const void *, size_t, uint64_t);
+int verify_files(const char *, const char *);
+
 #endif /* _LXTST_H */
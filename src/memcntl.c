@@ -37,7 +37,7 @@ struct memtest {
 static void
 tfail(char *msg)
 {
-	printf("FAIL %s %d: %s\n", TST_NAME, tc, msg);
+	(void) test_case_fail(TST_NAME, tc, msg);
 	exit(1);
 }
 
@@ -284,7 +284,7 @@ main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
-	tc = 1;
+	tc = test_case(TST_NAME, 1);
 
 	test_mlock();
 	test_madvise();
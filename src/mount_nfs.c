@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -44,7 +44,7 @@ static struct timespec delay = {
 static void
 tfail(char *msg)
 {
-	printf("FAIL %s %d: %s\n", TST_NAME, tc, msg);
+	(void) test_case_fail(TST_NAME, tc, msg);
 	exit(1);
 }
 
@@ -92,7 +92,7 @@ rpcbind_running()
 	return (0);
 }
 
-void
+static void
 lock_it(int fd)
 {
 	int res, l;
@@ -124,7 +124,7 @@ lock_it(int fd)
 	fdatasync(fd);
 }
 
-void
+static void
 unlock_it(int fd)
 {
 	int res, l;
@@ -257,7 +257,7 @@ main(int argc, char **argv)
 		return (test_fail(TST_NAME, "mkdir mountpoint failed"));
 
 	/* NFSv4 */
-	tc = 1;
+	tc = test_case(TST_NAME, 1);
 	(void) snprintf(opts, sizeof (opts), "addr=%s,proto=tcp,vers=4",
 	    hostaddr);
 	if (mount(mnt_server, MNT_PNT, FSTYPE, 0, opts) != 0) {
@@ -282,7 +282,7 @@ main(int argc, char **argv)
 
 	if (have_rpcbind) {
 		/* Test  NFSv4 locking */
-		tc = 2;
+		tc = test_case(TST_NAME, 2);
 		do_lock_test();
 	}
 
@@ -290,7 +290,7 @@ main(int argc, char **argv)
 
 no_v4:
 	/* NFSv3, as issued by the mount.nfs helper */
-	tc = 3;
+	tc = test_case(TST_NAME, 3);
 	(void) snprintf(opts, sizeof (opts),
 		"addr=%s,vers=3,proto=tcp,"
 		"mountvers=3,mountproto=tcp,mountport=%s",
@@ -311,14 +311,14 @@ no_v4:
 
 	if (have_rpcbind) {
 		/* Test  NFSv3 locking */
-		tc = 4;
+		tc = test_case(TST_NAME, 4);
 		do_lock_test();
 	}
 
 	(void) umount(MNT_PNT);
 
 	/* NFSv3 with some extra options */
-	tc = 5;
+	tc = test_case(TST_NAME, 5);
 	(void) snprintf(opts, sizeof (opts),
 		"addr=%s,vers=3,proto=tcp,nolock,bg,"
 		"mountvers=3,mountproto=tcp,mountport=%s",
@@ -339,7 +339,7 @@ no_v4:
 	(void) umount(MNT_PNT);
 
 	/* Attempt mount from unshared path */
-	tc = 6;
+	tc = test_case(TST_NAME, 6);
 	(void) snprintf(mnt_server, sizeof (mnt_server), "%s:%sFOO",
 		conf_nfs_server, conf_nfs_export);
 	(void) snprintf(opts, sizeof (opts),
@@ -352,7 +352,7 @@ no_v4:
 		conf_nfs_server, conf_nfs_export);
 
 	/* NFSv3 with sec=none */
-	tc = 7;
+	tc = test_case(TST_NAME, 7);
 	(void) snprintf(opts, sizeof (opts),
 		"addr=%s,vers=3,proto=tcp,sec=none,"
 		"mountvers=3,mountproto=tcp,mountport=%s",
@@ -364,7 +364,7 @@ no_v4:
 	 * Attempt mount using illumos security (diffie-hellman) name. This is
 	 * invalid on Linux.
 	 */
-	tc = 8;
+	tc = test_case(TST_NAME, 8);
 	(void) snprintf(opts, sizeof (opts),
 		"addr=%s,vers=3,proto=tcp,sec=dh,"
 		"mountvers=3,mountproto=tcp,mountport=%s",
@@ -375,7 +375,7 @@ no_v4:
 	/*
 	 * Attempt mount from invalid server (localhost)
 	 */
-	tc = 9;
+	tc = test_case(TST_NAME, 9);
 	(void) snprintf(opts, sizeof (opts),
 		"addr=127.0.0.1,vers=3,proto=tcp,"
 		"mountvers=3,mountproto=tcp,mountport=%s",
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <stdlib.h>
@@ -28,13 +28,16 @@ extern void *mremap (void *__addr, size_t __old_len, size_t __new_len,
 
 #define	ONEMB	(1024 * 1024)
 
+/* The pattern which the tests fill a mapping with before they remap it */
+#define	PSEED	0x6d72656d6170ULL
+
 static int tc;
 
 static void
 tfail(char *msg)
 {
-        printf("FAIL mremap %d: %s\n", tc, msg);
-        exit(1);
+	(void) test_case_fail("mremap", tc, msg);
+	exit(1);
 }
 
 /*
@@ -48,13 +51,24 @@ t_err(char *msg, int rc, int en)
 }
 */
 
+/* Check that a remapped region still holds the data it started with */
+static void
+check_data(void *a, size_t len)
+{
+	if (pattern_check(a, len, PSEED) != 0)
+		tfail("data not preserved");
+}
+
 static void
 run_test(int testcase, void (*tp)())
 {
 	int pid;
 	int status;
 
-	tc = testcase;;
+	if (!test_selected(testcase))
+		return;
+
+	tc = test_case("mremap", testcase);
 
 	pid = fork();
 	if (pid < 0)
@@ -86,18 +100,22 @@ test1()
 	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (a == MAP_FAILED)
 		tfail("mmap failed");
+	pattern_fill(a, 20 * ONEMB, PSEED);
 
 	a = mremap(a, 20 * ONEMB, 21 * ONEMB, MREMAP_MAYMOVE);
 	if (a == MAP_FAILED)
 		tfail("mremap failed");
+	check_data(a, 20 * ONEMB);
 
 	a = mremap(a, 21 * ONEMB, 20 * ONEMB, MREMAP_MAYMOVE);
 	if (a == MAP_FAILED)
 		tfail("mremap failed");
+	check_data(a, 20 * ONEMB);
 
 	a = mremap(a, 20 * ONEMB, 96 * ONEMB, MREMAP_MAYMOVE);
 	if (a == MAP_FAILED)
 		tfail("mremap failed");
+	check_data(a, 20 * ONEMB);
 
 	exit(0);
 }
@@ -114,6 +132,7 @@ test2()
 	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (a == MAP_FAILED)
 		tfail("mmap failed");
+	pattern_fill(a, 4096, PSEED);
 
 	/* Use mmap to get a valid fixed destination address */
 	tmp = mmap(NULL, 4096, PROT_READ | PROT_WRITE,
@@ -128,6 +147,7 @@ test2()
 
 	if (res != tmp)
 		tfail("mremap not at fixed address");
+	check_data(res, 4096);
 
 	exit(0);
 }
@@ -144,24 +164,28 @@ test3()
 	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (a == MAP_FAILED)
 		tfail("mmap failed");
+	pattern_fill(a, 5000, PSEED);
 
 	a = mremap(a, 5000, 10000, MREMAP_MAYMOVE);
 	if (a == MAP_FAILED)
 		tfail("mremap failed");
+	check_data(a, 5000);
 
 	a = mremap(a, 10000, 700000, MREMAP_MAYMOVE);
 	if (a == MAP_FAILED)
 		tfail("mremap failed");
+	check_data(a, 5000);
 
 	a = mremap(a, 700000, 10000000, MREMAP_MAYMOVE);
 	if (a == MAP_FAILED)
 		tfail("mremap failed");
+	check_data(a, 5000);
 
 	exit(0);
 }
 
 int
-main(void)
+main(int argc, char **argv)
 {
 	run_test(1, test1);
 	run_test(2, test2);
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2016, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -26,7 +26,7 @@
 #define TST_NAME	"procfs"
 #define MNT_PNT		"/proc"
 
-char *writable[] = {
+static char *writable[] = {
 	"/proc/self/loginuid",
 	"/proc/self/oom_score_adj",
 	"/proc/sys/kernel/core_pattern",
@@ -0,0 +1,181 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Rendezvous between the threads and processes of a test.
+ *
+ * Rather than polling a shared variable with a sleep in between, a thread can
+ * wait on an int with rdv_wait_ne() or rdv_wait_ge(), and is woken by futex as
+ * soon as another thread changes it with rdv_set(). Since the futexes aren't
+ * private, this also works for an int in memory shared between processes.
+ * Between a parent and child process, an eventfd can be used instead.
+ *
+ * A test often needs another thread to not only have reached a point, but to
+ * be blocked in the syscall which follows it. rdv_blocked() waits until the
+ * thread or process is asleep.
+ *
+ * None of these wait forever. They return -1 with errno set to ETIMEDOUT after
+ * RDV_TIMEOUT seconds, so that a test which gets out of step fails rather than
+ * hangs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+#include "lxtst.h"
+
+#define	RDV_TIMEOUT	10		/* seconds */
+
+static int
+timed_out(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec >= RDV_TIMEOUT);
+}
+
+static int
+rdv_wait(volatile int *p, int v, int ge)
+{
+	struct timespec start, ts = { 0, 100000000 };
+	int cur;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		cur = __atomic_load_n(p, __ATOMIC_SEQ_CST);
+		if (ge ? cur >= v : cur != v)
+			return (0);
+		if (timed_out(&start)) {
+			errno = ETIMEDOUT;
+			return (-1);
+		}
+		(void) syscall(SYS_futex, p, FUTEX_WAIT, cur, &ts, NULL, 0);
+	}
+}
+
+/* Wait until *p != v */
+int
+rdv_wait_ne(volatile int *p, int v)
+{
+	return (rdv_wait(p, v, 0));
+}
+
+/* Wait until *p >= v */
+int
+rdv_wait_ge(volatile int *p, int v)
+{
+	return (rdv_wait(p, v, 1));
+}
+
+/* Set *p to v and wake everything waiting on it */
+void
+rdv_set(volatile int *p, int v)
+{
+	__atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+	(void) syscall(SYS_futex, p, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* The state of a thread of this process, or of another process. */
+static int
+task_state(int id)
+{
+	char path[64], buf[512], *s;
+	int fd;
+	ssize_t len;
+
+	(void) snprintf(path, sizeof (path), "/proc/self/task/%d/stat", id);
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		(void) snprintf(path, sizeof (path), "/proc/%d/stat", id);
+		if ((fd = open(path, O_RDONLY)) < 0)
+			return (-1);
+	}
+	len = read(fd, buf, sizeof (buf) - 1);
+	(void) close(fd);
+	if (len <= 0)
+		return (-1);
+	buf[len] = '\0';
+
+	/* The command name can hold anything, so skip past its last ')' */
+	if ((s = strrchr(buf, ')')) == NULL || s[1] != ' ')
+		return (-1);
+	return (s[2]);
+}
+
+/*
+ * Wait until the given thread (of this process) or process is asleep, e.g.
+ * blocked in a syscall.
+ */
+int
+rdv_blocked(int id)
+{
+	struct timespec start, ts = { 0, 20000 };
+	int st;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		if ((st = task_state(id)) < 0) {
+			errno = ESRCH;
+			return (-1);
+		}
+		if (st == 'S' || st == 'D')
+			return (0);
+		if (timed_out(&start)) {
+			errno = ETIMEDOUT;
+			return (-1);
+		}
+		(void) nanosleep(&ts, NULL);
+	}
+}
+
+/* An eventfd for signalling between a parent and child process */
+int
+rdv_efd()
+{
+	return (eventfd(0, EFD_CLOEXEC));
+}
+
+int
+rdv_efd_post(int fd)
+{
+	uint64_t v = 1;
+
+	return (write(fd, &v, sizeof (v)) == sizeof (v) ? 0 : -1);
+}
+
+/* Wait for a post, consuming all posts made so far */
+int
+rdv_efd_wait(int fd)
+{
+	struct pollfd pfd;
+	uint64_t v;
+	int rc;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while ((rc = poll(&pfd, 1, RDV_TIMEOUT * 1000)) < 0 && errno == EINTR)
+		;
+	if (rc == 0) {
+		errno = ETIMEDOUT;
+		return (-1);
+	}
+	if (rc < 0 || read(fd, &v, sizeof (v)) != sizeof (v))
+		return (-1);
+	return (0);
+}
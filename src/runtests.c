@@ -0,0 +1,409 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Parallel test runner.
+ *
+ * Runs the test binaries named on the command line, up to one per online CPU
+ * at a time. Each test runs in its own process group with its stdout and
+ * stderr captured, so that the output of concurrent tests is not interleaved.
+ * When a test finishes its output is printed as a block, followed by a TIME
+ * line with the wall and CPU time used by the test and all of its descendants.
+ *
+ * A test which runs past its time budget has its whole process group killed
+ * and is reported as a failure.
+ *
+ * Tests which cannot share the zone with each other (e.g. because they use the
+ * same mount point) are named with -s. At most one of those runs at a time,
+ * although they still run concurrently with the other tests.
+ *
+ * usage: runtests [-j jobs] [-t timeout] [-s test]... test...
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define	DFLT_TIMEOUT	300		/* seconds */
+#define	MAX_SERIAL	32
+
+typedef enum {
+	T_WAIT,
+	T_RUN,
+	T_DONE
+} tstate_t;
+
+typedef struct test {
+	char		*t_name;
+	tstate_t	t_state;
+	int		t_serial;
+	pid_t		t_pid;
+	int		t_fd;		/* read side of output pipe */
+	char		*t_out;		/* captured output */
+	size_t		t_outlen;
+	size_t		t_outsz;
+	struct timespec	t_start;
+	struct timespec	t_end;
+	int		t_timedout;
+	int		t_status;
+	struct rusage	t_ru;
+} test_t;
+
+static char *progname;
+static int sig_pipe[2];
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s [-j jobs] [-t timeout] [-s test]... "
+	    "test...\n", progname);
+	exit(2);
+}
+
+static void
+fatal(const char *msg)
+{
+	fprintf(stderr, "%s: %s: %s\n", progname, msg, strerror(errno));
+	exit(2);
+}
+
+static void
+sigchld(int sig)
+{
+	int oerrno = errno;
+
+	(void) write(sig_pipe[1], "", 1);
+	errno = oerrno;
+}
+
+static double
+ts_diff(struct timespec *end, struct timespec *start)
+{
+	return ((end->tv_sec - start->tv_sec) +
+	    (end->tv_nsec - start->tv_nsec) / 1e9);
+}
+
+static double
+tv_secs(struct timeval *tv)
+{
+	return (tv->tv_sec + tv->tv_usec / 1e6);
+}
+
+static void
+set_flags(int fd)
+{
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 ||
+	    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+		fatal("fcntl");
+}
+
+static void
+start_test(test_t *tp)
+{
+	int pfd[2];
+	char path[1024];
+
+	if (pipe(pfd) != 0)
+		fatal("pipe");
+
+	/* Run tests out of the current directory unless given a path. */
+	if (strchr(tp->t_name, '/') == NULL) {
+		snprintf(path, sizeof (path), "./%s", tp->t_name);
+	} else {
+		snprintf(path, sizeof (path), "%s", tp->t_name);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &tp->t_start);
+	tp->t_pid = fork();
+	if (tp->t_pid < 0)
+		fatal("fork");
+
+	if (tp->t_pid == 0) {
+		/* child */
+		(void) setpgid(0, 0);
+		(void) signal(SIGCHLD, SIG_DFL);
+		close(pfd[0]);
+		if (dup2(pfd[1], 1) < 0 || dup2(pfd[1], 2) < 0)
+			_exit(127);
+		close(pfd[1]);
+
+		/*
+		 * Some tests expect stdin to be a pipe or terminal (e.g. aio
+		 * uses fd 0 as an fd which aio doesn't support), and must not
+		 * block reading from it. Give them a pipe which is at EOF.
+		 */
+		if (pipe(pfd) != 0 || dup2(pfd[0], 0) < 0)
+			_exit(127);
+		close(pfd[1]);
+		if (pfd[0] != 0)
+			close(pfd[0]);
+		execl(path, path, NULL);
+		fprintf(stderr, "FAIL %s: exec: %s\n", tp->t_name,
+		    strerror(errno));
+		_exit(127);
+	}
+
+	/* Also set in the parent to avoid racing with the child's setpgid. */
+	(void) setpgid(tp->t_pid, tp->t_pid);
+	close(pfd[1]);
+	set_flags(pfd[0]);
+	tp->t_fd = pfd[0];
+	tp->t_state = T_RUN;
+}
+
+/* Pull whatever output is available from a test. */
+static void
+drain_test(test_t *tp)
+{
+	ssize_t len;
+
+	if (tp->t_fd < 0)
+		return;
+
+	for (;;) {
+		if (tp->t_outsz - tp->t_outlen < 4096) {
+			tp->t_outsz = (tp->t_outsz == 0) ? 8192 :
+			    tp->t_outsz * 2;
+			if ((tp->t_out = realloc(tp->t_out, tp->t_outsz)) ==
+			    NULL)
+				fatal("realloc");
+		}
+
+		len = read(tp->t_fd, tp->t_out + tp->t_outlen,
+		    tp->t_outsz - tp->t_outlen);
+		if (len > 0) {
+			tp->t_outlen += len;
+			continue;
+		}
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len == 0) {
+			/* EOF */
+			close(tp->t_fd);
+			tp->t_fd = -1;
+		}
+		return;
+	}
+}
+
+static int
+report_test(test_t *tp)
+{
+	int failed;
+	double wall;
+
+	/*
+	 * Orphaned descendants of the test may still hold the pipe open, so
+	 * take what is there now and don't wait for EOF.
+	 */
+	drain_test(tp);
+	if (tp->t_fd >= 0) {
+		close(tp->t_fd);
+		tp->t_fd = -1;
+	}
+
+	if (tp->t_outlen > 0) {
+		fwrite(tp->t_out, 1, tp->t_outlen, stdout);
+		if (tp->t_out[tp->t_outlen - 1] != '\n')
+			fputc('\n', stdout);
+	}
+	free(tp->t_out);
+	tp->t_out = NULL;
+
+	wall = ts_diff(&tp->t_end, &tp->t_start);
+	failed = 1;
+	if (tp->t_timedout) {
+		printf("FAIL %s: timed out after %.3fs\n", tp->t_name, wall);
+	} else if (WIFSIGNALED(tp->t_status)) {
+		printf("FAIL %s: killed by signal %d\n", tp->t_name,
+		    WTERMSIG(tp->t_status));
+	} else if (WEXITSTATUS(tp->t_status) != 0) {
+		/* The test has already said why */
+	} else {
+		failed = 0;
+	}
+
+	printf("TIME %s: wall %.3fs user %.3fs sys %.3fs\n", tp->t_name, wall,
+	    tv_secs(&tp->t_ru.ru_utime), tv_secs(&tp->t_ru.ru_stime));
+	fflush(stdout);
+
+	return (failed);
+}
+
+int
+main(int argc, char **argv)
+{
+	test_t *tests;
+	struct pollfd *pfds;
+	char *serial[MAX_SERIAL];
+	int nserial = 0;
+	int ntests, njobs, timeout, running, serial_busy, ndone, nfailed;
+	int c, i;
+	struct timespec begin, now;
+
+	progname = argv[0];
+	njobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	timeout = DFLT_TIMEOUT;
+
+	while ((c = getopt(argc, argv, "j:s:t:")) != -1) {
+		switch (c) {
+		case 'j':
+			njobs = atoi(optarg);
+			break;
+		case 's':
+			if (nserial == MAX_SERIAL)
+				usage();
+			serial[nserial++] = optarg;
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (njobs < 1)
+		njobs = 1;
+
+	ntests = argc - optind;
+	if (ntests == 0 || timeout < 1)
+		usage();
+
+	if ((tests = calloc(ntests, sizeof (test_t))) == NULL ||
+	    (pfds = calloc(ntests + 1, sizeof (struct pollfd))) == NULL)
+		fatal("calloc");
+
+	for (i = 0; i < ntests; i++) {
+		int j;
+
+		tests[i].t_name = argv[optind + i];
+		tests[i].t_fd = -1;
+		for (j = 0; j < nserial; j++) {
+			if (strcmp(serial[j], tests[i].t_name) == 0)
+				tests[i].t_serial = 1;
+		}
+	}
+
+	if (pipe(sig_pipe) != 0)
+		fatal("pipe");
+	set_flags(sig_pipe[0]);
+	set_flags(sig_pipe[1]);
+	if (signal(SIGCHLD, sigchld) == SIG_ERR)
+		fatal("signal");
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	running = serial_busy = ndone = nfailed = 0;
+
+	while (ndone < ntests) {
+		int npfd, wait_ms;
+		pid_t pid;
+		int status;
+		struct rusage ru;
+
+		/* Start as many waiting tests as we are allowed to. */
+		for (i = 0; i < ntests && running < njobs; i++) {
+			if (tests[i].t_state != T_WAIT)
+				continue;
+			if (tests[i].t_serial) {
+				if (serial_busy)
+					continue;
+				serial_busy = 1;
+			}
+			start_test(&tests[i]);
+			running++;
+		}
+
+		/*
+		 * Sleep until a test produces output, exits, or hits its time
+		 * budget.
+		 */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		wait_ms = -1;
+		npfd = 0;
+		pfds[npfd].fd = sig_pipe[0];
+		pfds[npfd++].events = POLLIN;
+		for (i = 0; i < ntests; i++) {
+			test_t *tp = &tests[i];
+			int left;
+
+			if (tp->t_state != T_RUN)
+				continue;
+
+			if (tp->t_fd >= 0) {
+				pfds[npfd].fd = tp->t_fd;
+				pfds[npfd++].events = POLLIN;
+			}
+
+			if (tp->t_timedout)
+				continue;
+			left = (int)((timeout - ts_diff(&now, &tp->t_start)) *
+			    1000) + 1;
+			if (left <= 0) {
+				tp->t_timedout = 1;
+				(void) kill(-tp->t_pid, SIGKILL);
+				continue;
+			}
+			if (wait_ms < 0 || left < wait_ms)
+				wait_ms = left;
+		}
+
+		if (poll(pfds, npfd, wait_ms) < 0 && errno != EINTR)
+			fatal("poll");
+
+		for (i = 0; i < ntests; i++) {
+			if (tests[i].t_state == T_RUN)
+				drain_test(&tests[i]);
+		}
+
+		/* Empty the wakeup pipe, then reap. */
+		while (read(sig_pipe[0], &c, sizeof (c)) > 0)
+			;
+
+		while ((pid = wait4(-1, &status, WNOHANG, &ru)) > 0) {
+			for (i = 0; i < ntests; i++) {
+				if (tests[i].t_state == T_RUN &&
+				    tests[i].t_pid == pid)
+					break;
+			}
+			if (i == ntests)
+				continue;
+
+			clock_gettime(CLOCK_MONOTONIC, &tests[i].t_end);
+			tests[i].t_status = status;
+			tests[i].t_ru = ru;
+			tests[i].t_state = T_DONE;
+
+			/* Clean up anything the test left behind. */
+			(void) kill(-pid, SIGKILL);
+
+			nfailed += report_test(&tests[i]);
+			if (tests[i].t_serial)
+				serial_busy = 0;
+			running--;
+			ndone++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	printf("TIME total: %d tests, %d failed, wall %.3fs\n", ntests, nfailed,
+	    ts_diff(&now, &begin));
+
+	return (nfailed == 0 ? 0 : 1);
+}
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2016, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <sched.h>
@@ -24,16 +24,17 @@
 #define	SCHED_IDLE	5
 #endif
 
-static int chld_tid;
-static int chld_done;
+static volatile int chld_tid;
+static volatile int chld_done;
 
 static int
 thr(void *a)
 {
 	/* thread */
-	chld_tid = syscall(186);
-	while (chld_done == 0)
-		usleep(1000);
+	rdv_set(&chld_tid, syscall(186));
+	/* the main thread may take a while, so keep waiting past the timeout */
+	while (rdv_wait_ne(&chld_done, 0) != 0)
+		;
         return (0);
 }
 
@@ -129,8 +130,8 @@ main(int argc, char **argv)
 		return (test_fail("sched", "pthread_create failed"));
 
 	/* main thread */
-	while (chld_tid == 0)
-		usleep(1000);
+	if (rdv_wait_ne(&chld_tid, 0) != 0)
+		return (test_fail("sched", "thread did not start"));
 
 	/* Test 9 - getscheduler for thread */
 	res = sched_getscheduler(chld_tid);
@@ -205,7 +206,7 @@ main(int argc, char **argv)
 	if (res < 0 || res != SCHED_OTHER)
 		return (test_fail("sched 21", "get: incorrect class"));
 
-	chld_done = 1;
+	rdv_set(&chld_done, 1);
 	pthread_join(tid, &rv);
 
 	/*
@@ -452,8 +453,8 @@ main(int argc, char **argv)
 		return (test_fail("sched", "pthread_create failed"));
 
 	/* main thread */
-	while (chld_tid == 0)
-		usleep(1000);
+	if (rdv_wait_ne(&chld_tid, 0) != 0)
+		return (test_fail("sched", "thread did not start"));
 
 	/* Test 54 - getscheduler for thread */
 	res = sched_getscheduler(chld_tid);
@@ -508,7 +509,7 @@ main(int argc, char **argv)
 	if (res < 0 || tp.tv_sec != 0 || tp.tv_nsec == 0)
 		return (test_fail("sched 63", "get interval: incorrect"));
 
-	chld_done = 1;
+	rdv_set(&chld_done, 1);
 	pthread_join(tid, &rv);
 
 	/*
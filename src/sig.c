@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -22,7 +22,6 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/un.h>
-#include <netdb.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <sys/utsname.h>
@@ -42,9 +41,9 @@ static struct timespec delay;
 static void
 tfail(char *msg)
 {
-	printf("FAIL sig %d: %s\n", tc, msg);
+	(void) test_case_fail("sig", tc, msg);
 	(void) unlink(tst_file);
-        exit(1);
+	exit(1);
 }
 
 static void
@@ -64,27 +63,24 @@ handler(int signo, siginfo_t *sip, void *cp)
 
 /* Setup for a connection, but don't actually accept it */
 static int
-tsrv()
+tsrv(int *portp)
 {
-	struct sockaddr_in addr;
 	int fd;
 
-	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-                t_err("socket", fd, errno);
-   
-	bzero((char *) &addr, sizeof(addr));
-   
-	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = INADDR_ANY;
-	addr.sin_port = htons(5001);
-   
-	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
-                t_err("bind", -1, errno);
-
-	if (listen(fd, 5) == -1)
-                t_err("listen", -1, errno);
-
-	return(fd);
+	if ((fd = loopback_listen(portp)) < 0)
+		t_err("listen", fd, errno);
+
+	return (fd);
+}
+
+/* Wait for the child to say it's ready and then block, e.g. in accept */
+static void
+wait_child(int efd, int pid)
+{
+	if (rdv_efd_wait(efd) != 0)
+		t_err("child ready", -1, errno);
+	if (rdv_blocked(pid) != 0)
+		t_err("child block", -1, errno);
 }
 
 /* Handle SIGINT and restart interrupted syscall */
@@ -102,10 +98,9 @@ setup_sighand()
 }
 
 static void
-child_accept(int pfd, int should_intr)
+child_accept(int efd, int should_intr)
 {
-	struct sockaddr_in addr;
-	int fd, cl;
+	int fd, cl, port;
 	struct timeval tv;
 
 	setup_sighand();
@@ -113,9 +108,8 @@ child_accept(int pfd, int should_intr)
 	tv.tv_sec = 5;
 	tv.tv_usec = 0;
 
-	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-                t_err("socket", fd, errno);
-   
+	fd = tsrv(&port);
+
 	/* Set a timeout so that the signal will not cause restart */
 	if (should_intr) {
 		if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv,
@@ -123,22 +117,8 @@ child_accept(int pfd, int should_intr)
                 	t_err("setsockopt", 0, errno);
 	}
 
-	bzero((char *) &addr, sizeof(addr));
-  
-	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = INADDR_ANY;
-	addr.sin_port = htons(5001);
-   
-	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
-               	t_err("bind", 0, errno);
-
-	if (listen(fd, 5) == -1) {
-		perror("listen error");
-		exit(1);
-	}
-
 	/* tell the parent we're ready */
-	(void) write(pfd, "\n", 1);
+	(void) rdv_efd_post(efd);
 
 	if ((cl = accept(fd, NULL, NULL)) == -1) {
 		if (!should_intr) {
@@ -154,11 +134,9 @@ child_accept(int pfd, int should_intr)
 }
 
 static void
-child_recv(int pfd, int should_intr)
+child_recv(int efd, int should_intr, int port)
 {
-	struct sockaddr_in addr;
 	int fd;
-	struct hostent *server;
 	struct timeval tv;
 	char buf[80];
 
@@ -167,8 +145,8 @@ child_recv(int pfd, int should_intr)
 	tv.tv_sec = 5;
 	tv.tv_usec = 0;
 
-	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
-                t_err("socket", fd, errno);
+	if ((fd = loopback_connect(port)) < 0)
+               	t_err("connect", fd, errno);
 
 	/* Set a timeout so that the signal will not cause restart */
 	if (should_intr) {
@@ -177,21 +155,8 @@ child_recv(int pfd, int should_intr)
                 	t_err("setsockopt", 0, errno);
 	}
 
-	server = gethostbyname("localhost");
-	if (server == NULL)
-               	t_err("gethostbyname", 0, errno);
-   
-	bzero((char *) &addr, sizeof(addr));
-	addr.sin_family = AF_INET;
-	bcopy((char *)server->h_addr, (char *)&addr.sin_addr.s_addr,
-	    server->h_length);
-	addr.sin_port = htons(5001);
-   
-	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
-               	t_err("connect", 0, errno);
-
 	/* tell the parent we're ready */
-	(void) write(pfd, "\n", 1);
+	(void) rdv_efd_post(efd);
 
 	if (recv(fd, buf, sizeof (buf), 0) < 0) {
 		if (!should_intr) {
@@ -207,7 +172,7 @@ child_recv(int pfd, int should_intr)
 }
 
 static void
-child_flock(int pfd)
+child_flock(int efd)
 {
 	int fd;
 
@@ -217,7 +182,7 @@ child_flock(int pfd)
                 t_err("open", fd, errno);
 
 	/* tell the parent we're ready */
-	(void) write(pfd, "\n", 1);
+	(void) rdv_efd_post(efd);
 
 	if (flock(fd, LOCK_EX) < 0)
                	t_err("flock", fd, errno);
@@ -225,7 +190,7 @@ child_flock(int pfd)
 }
 
 static void
-child_fcntl(int pfd)
+child_fcntl(int efd)
 {
 	int fd;
 	struct flock fl;
@@ -241,7 +206,7 @@ child_fcntl(int pfd)
 	fl.l_len = 0;
 
 	/* tell the parent we're ready */
-	(void) write(pfd, "\n", 1);
+	(void) rdv_efd_post(efd);
 
 	if (fcntl(fd, F_SETLKW, &fl) < 0)
                	t_err("fcntl", fd, errno);
@@ -255,27 +220,21 @@ static int
 test1()
 {
 	int pid;
-	int pfd[2];
-	char buf[80];
+	int efd;
 	int status;
 
-	tc = 1;
+	tc = test_case("sig", 1);
 
-	if (pipe(pfd) != 0)
-                t_err("pipe", 0, errno);
+	if ((efd = rdv_efd()) < 0)
+		t_err("eventfd", efd, errno);
 
 	pid = fork();
 	if (pid == 0) {
-		close(pfd[0]);
-		child_accept(pfd[1], 0);
+		child_accept(efd, 0);
 		exit(0);
 	}
-	close(pfd[1]);
 
-	/* wait until child is ready */
-	if (read(pfd[0], buf, sizeof (buf)) < 0)
-                t_err("read", 0, errno);
-	nanosleep(&delay, NULL);
+	wait_child(efd, pid);
 
 	/* child accept syscall should restart from this */
 	kill(pid, SIGINT);
@@ -287,7 +246,7 @@ test1()
 	waitpid(pid, &status, 0);
 	if (WEXITSTATUS(status) != 0)
                 t_err("waitpid", status, errno);
-	close(pfd[0]);
+	close(efd);
 	return (0);
 }
 
@@ -298,27 +257,21 @@ static int
 test2()
 {
 	int pid;
-	int pfd[2];
-	char buf[80];
+	int efd;
 	int status;
 
-	tc = 2;
+	tc = test_case("sig", 2);
 
-	if (pipe(pfd) != 0)
-                t_err("pipe", 0, errno);
+	if ((efd = rdv_efd()) < 0)
+		t_err("eventfd", efd, errno);
 
 	pid = fork();
 	if (pid == 0) {
-		close(pfd[0]);
-		child_accept(pfd[1], 1);
+		child_accept(efd, 1);
 		exit(0);
 	}
-	close(pfd[1]);
 
-	/* wait until child is ready */
-	if (read(pfd[0], buf, sizeof (buf)) < 0)
-                t_err("read", 0, errno);
-	nanosleep(&delay, NULL);
+	wait_child(efd, pid);
 
 	/* child accept should get EINTR */
 	kill(pid, SIGINT);
@@ -326,7 +279,7 @@ test2()
 	waitpid(pid, &status, 0);
 	if (WEXITSTATUS(status) != 0)
                 t_err("waitpid", status, errno);
-	close(pfd[0]);
+	close(efd);
 	return (0);
 }
 
@@ -337,28 +290,22 @@ static int
 test3()
 {
 	int pid;
-	int fd, pfd[2];
-	char buf[80];
+	int fd, port, efd;
 	int status;
 
-	tc = 3;
+	tc = test_case("sig", 3);
 
-	if (pipe(pfd) != 0)
-                t_err("pipe", 0, errno);
-	fd = tsrv();
+	if ((efd = rdv_efd()) < 0)
+		t_err("eventfd", efd, errno);
+	fd = tsrv(&port);
 
 	pid = fork();
 	if (pid == 0) {
-		close(pfd[0]);
-		child_recv(pfd[1], 0);
+		child_recv(efd, 0, port);
 		exit(0);
 	}
-	close(pfd[1]);
 
-	/* wait until child is ready */
-	if (read(pfd[0], buf, sizeof (buf)) < 0)
-                t_err("read", 0, errno);
-	nanosleep(&delay, NULL);
+	wait_child(efd, pid);
 
 	/* child recv syscall should restart from this */
 	kill(pid, SIGINT);
@@ -371,7 +318,7 @@ test3()
 	if (WEXITSTATUS(status) != 0)
                 t_err("waitpid", status, errno);
 	close(fd);
-	close(pfd[0]);
+	close(efd);
 	return (0);
 }
 
@@ -382,28 +329,22 @@ static int
 test4()
 {
 	int pid;
-	int fd, pfd[2];
-	char buf[80];
+	int fd, port, efd;
 	int status;
 
-	tc = 4;
+	tc = test_case("sig", 4);
 
-	if (pipe(pfd) != 0)
-                t_err("pipe", 0, errno);
-	fd = tsrv();
+	if ((efd = rdv_efd()) < 0)
+		t_err("eventfd", efd, errno);
+	fd = tsrv(&port);
 
 	pid = fork();
 	if (pid == 0) {
-		close(pfd[0]);
-		child_recv(pfd[1], 1);
+		child_recv(efd, 1, port);
 		exit(0);
 	}
-	close(pfd[1]);
 
-	/* wait until child is ready */
-	if (read(pfd[0], buf, sizeof (buf)) < 0)
-                t_err("read", 0, errno);
-	nanosleep(&delay, NULL);
+	wait_child(efd, pid);
 
 	/* child recv should get EINTR */
 	kill(pid, SIGINT);
@@ -412,7 +353,7 @@ test4()
 	if (WEXITSTATUS(status) != 0)
                 t_err("waitpid", status, errno);
 	close(fd);
-	close(pfd[0]);
+	close(efd);
 	return (0);
 }
 
@@ -423,14 +364,13 @@ static int
 test5()
 {
 	int pid;
-	int fd, pfd[2];
-	char buf[80];
+	int fd, efd;
 	int status;
 
-	tc = 5;
+	tc = test_case("sig", 5);
 
-	if (pipe(pfd) != 0)
-                t_err("pipe", 0, errno);
+	if ((efd = rdv_efd()) < 0)
+		t_err("eventfd", efd, errno);
 
 	if ((fd = open(tst_file, O_RDWR | O_CREAT, 0666)) < 0)
                 t_err("open", fd, errno);
@@ -439,16 +379,11 @@ test5()
 
 	pid = fork();
 	if (pid == 0) {
-		close(pfd[0]);
-		child_flock(pfd[1]);
+		child_flock(efd);
 		exit(0);
 	}
-	close(pfd[1]);
 
-	/* wait until child is ready */
-	if (read(pfd[0], buf, sizeof (buf)) < 0)
-                t_err("read", 0, errno);
-	nanosleep(&delay, NULL);
+	wait_child(efd, pid);
 
 	/* child flock should get EINTR */
 	kill(pid, SIGINT);
@@ -463,7 +398,7 @@ test5()
 	(void) flock(fd, LOCK_UN);
 	close(fd);
 	(void) unlink(tst_file);
-	close(pfd[0]);
+	close(efd);
 	return (0);
 }
 
@@ -474,15 +409,14 @@ static int
 test6()
 {
 	int pid;
-	int fd, pfd[2];
-	char buf[80];
+	int fd, efd;
 	int status;
 	struct flock fl;
 
-	tc = 6;
+	tc = test_case("sig", 6);
 
-	if (pipe(pfd) != 0)
-                t_err("pipe", 0, errno);
+	if ((efd = rdv_efd()) < 0)
+		t_err("eventfd", efd, errno);
 
 	if ((fd = open(tst_file, O_RDWR | O_CREAT, 0666)) < 0)
                 t_err("open", fd, errno);
@@ -497,16 +431,11 @@ test6()
 
 	pid = fork();
 	if (pid == 0) {
-		close(pfd[0]);
-		child_fcntl(pfd[1]);
+		child_fcntl(efd);
 		exit(0);
 	}
-	close(pfd[1]);
 
-	/* wait until child is ready */
-	if (read(pfd[0], buf, sizeof (buf)) < 0)
-                t_err("read", 0, errno);
-	nanosleep(&delay, NULL);
+	wait_child(efd, pid);
 
 	/* child flock should get EINTR */
 	kill(pid, SIGINT);
@@ -523,7 +452,7 @@ test6()
 
 	close(fd);
 	(void) unlink(tst_file);
-	close(pfd[0]);
+	close(efd);
 	return (0);
 }
 
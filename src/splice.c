@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -21,7 +21,6 @@
 #include <sys/socket.h>
 #include <sys/utsname.h>
 #include <sys/un.h>
-#include <netdb.h>
 #include <netinet/in.h>
 #include "lxtst.h"
 
@@ -37,7 +36,7 @@ extern ssize_t splice(int, loff_t *, int, loff_t *, size_t, unsigned int);
 
 static int is_lx = 0;
 static int tc;
-static int server_fd, server_acc_fd;
+static int server_fd, server_acc_fd, server_port;
 static int timed_out;
 
 #define	DFLT_PIPE_SIZE	(64 * 1024)
@@ -50,14 +49,15 @@ static int timed_out;
 typedef struct {
 	int	fd0;
 	int	fd1;
+	int	tid;		/* thread to wait on before closing */
 } fd_args_t;
 
 static void
 tfail(char *msg)
 {
-        printf("FAIL splice %d: %s\n", tc, msg);
+	(void) test_case_fail("splice", tc, msg);
 	unlink(DFILE_NAME);
-        exit(1);
+	exit(1);
 }
 
 static void
@@ -72,33 +72,10 @@ t_err(char *msg, int rc, int en)
 static int
 sock_client()
 {
-	struct sockaddr_in addr;
 	int fd;
-	struct hostent *server;
-
-	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-		perror("socket error");
-		exit(-1);
-	}
-	
-	server = gethostbyname("localhost");
-	if (server == NULL) {
-		fprintf(stderr,"ERROR, no such host\n");
-		exit(0);
-	}
-   
-	bzero((char *) &addr, sizeof(addr));
-	addr.sin_family = AF_INET;
-	bcopy((char *)server->h_addr, (char *)&addr.sin_addr.s_addr,
-	    server->h_length);
-	addr.sin_port = htons(5001);
-   
-	/* Now connect to the server */
-	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-		perror("connect error");
-		exit(-1);
-	}
 
+	if ((fd = loopback_connect(server_port)) < 0)
+		t_err("connect", fd, errno);
 	return (fd);
 }
 
@@ -124,37 +101,14 @@ sock_fill()
 	close(sfd);
 }
 
+/* Accept a connection on the listener which main() sets up. */
 static int
 sock_serv()
 {
-	struct sockaddr_in addr;
 	int cl;
 
-	if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-		perror("socket error");
-		exit(-1);
-	}
-   
-	bzero((char *) &addr, sizeof(addr));
-   
-	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = INADDR_ANY;
-	addr.sin_port = htons(5001);
-   
-	if (bind(server_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-		perror("bind error");
-		exit(-1);
-	}
-
-	if (listen(server_fd, 5) == -1) {
-		perror("listen error");
-		exit(-1);
-	}
-
-	if ((cl = accept(server_fd, NULL, NULL)) == -1) {
-		perror("accept error");
-		exit(1);
-	}
+	if ((cl = accept(server_fd, NULL, NULL)) == -1)
+		t_err("accept", cl, errno);
 	server_acc_fd = cl;
 
 	return (cl);
@@ -165,12 +119,10 @@ fd_close(void *a)
 {
 	int rc;
 	fd_args_t *ap = (fd_args_t *)a;
-	struct timespec delay;
-
-	delay.tv_sec = 0;
-	delay.tv_nsec = 1000000;
 
-	nanosleep(&delay, NULL);
+	/* wait for the splice to block */
+	if ((rc = rdv_blocked(ap->tid)) != 0)
+		t_err("blocked", rc, errno);
 
 	if ((rc = close(ap->fd0)) != 0)
 		t_err("close", rc, errno);
@@ -205,15 +157,14 @@ create_data_file(int fsize)
 	close(fd);
 }
 
+/* Does the output file match the data file? */
 static int
 validate_data()
 {
 	int res;
-	char cmd[512];
 
-	snprintf(cmd, sizeof (cmd), "/usr/bin/diff %s %s >/dev/null 2>&1",
-	    DFILE_NAME, TMP_FILE);
-	res = system(cmd);
+	if ((res = verify_files(DFILE_NAME, TMP_FILE)) < 0)
+		t_err("verify", res, errno);
 	return (res == 0);
 }
 
@@ -228,7 +179,7 @@ test1(int file_size)
 	ssize_t s, len;
 	char buf[64 * 1024];
 
-	tc = 1;
+	tc = test_case("splice", 1);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -255,6 +206,7 @@ test1(int file_size)
 		(void) write(tfd, buf, len);
 	}
 
+	close(tfd);
 	close(pfd[0]);
 	if (!validate_data())
 		tfail("file comparison failed");
@@ -271,7 +223,7 @@ test2(int file_size)
 	ssize_t s, len;
 	char buf[64 * 1024];
 
-	tc = 2;
+	tc = test_case("splice", 2);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -319,7 +271,7 @@ test3(int file_size)
 	loff_t off_in;
 	char buf[64 * 1024];
 
-	tc = 3;
+	tc = test_case("splice", 3);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -348,6 +300,7 @@ test3(int file_size)
 		(void) write(tfd, buf, len);
 	}
 
+	close(tfd);
 	close(pfd[0]);
 	if (validate_data())
 		tfail("file comparison succeeded");
@@ -367,7 +320,7 @@ test4(int file_size)
 	char buf[64 * 1024], tbuf[32];
 	struct stat sb;
 
-	tc = 4;
+	tc = test_case("splice", 4);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -446,7 +399,7 @@ test5(int file_size)
 	ssize_t s, len;
 	char buf[64 * 1024];
 
-	tc = 5;
+	tc = test_case("splice", 5);
 
 	/* Setup a socket and write our data file into it. */
 	pthread_create(&tid, NULL, (void *(*)(void *))sock_fill, (void *)NULL);
@@ -476,11 +429,11 @@ test5(int file_size)
 		(void) write(tfd, buf, len);
 	}
 
+	close(tfd);
 	close(pfd[0]);
 	if (!validate_data())
 		tfail("file comparison failed");
 
-	close(server_fd);
 	unlink(TMP_FILE);
 }
 
@@ -495,13 +448,10 @@ test6(int file_size)
 	ssize_t s, len;
 	char buf[64 * 1024];
 
-	tc = 6;
+	tc = test_case("splice", 6);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
-	if ((tfd = open(TMP_FILE, O_WRONLY | O_CREAT, 0644)) < 0)
-		t_err("open", tfd, errno);
-
 	if ((rc = pipe(pfd)) != 0)
 		t_err("pipe", rc, errno);
 
@@ -545,7 +495,6 @@ test6(int file_size)
 		tfail("file comparison failed");
 
 	close(server_acc_fd);
-	close(server_fd);
 	unlink(TMP_FILE);
 }
 
@@ -560,7 +509,7 @@ test7(int file_size)
 	ssize_t s, len;
 	char buf[64 * 1024];
 
-	tc = 7;
+	tc = test_case("splice", 7);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -615,7 +564,7 @@ test8()
 	int rc, tfd, pfd[2];
 	ssize_t s;
 
-	tc = 8;
+	tc = test_case("splice", 8);
 	if ((tfd = open(TMP_FILE, O_WRONLY | O_CREAT, 0644)) < 0)
 		t_err("open", tfd, errno);
 
@@ -648,7 +597,7 @@ test9()
 	ssize_t s;
 	struct sigaction act;
 
-	tc = 9;
+	tc = test_case("splice", 9);
 	if ((tfd = open(TMP_FILE, O_WRONLY | O_CREAT, 0644)) < 0)
 		t_err("open", tfd, errno);
 
@@ -694,7 +643,7 @@ test10(int file_size)
 	char buf[64 * 1024];
 	struct stat sb;
 
-	tc = 10;
+	tc = test_case("splice", 10);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -746,7 +695,7 @@ test11(int file_size)
 	char buf[64 * 1024];
 	struct stat sb;
 
-	tc = 11;
+	tc = test_case("splice", 11);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -808,7 +757,7 @@ test12(int file_size)
 	struct stat sb;
 	struct sigaction act;
 
-	tc = 12;
+	tc = test_case("splice", 12);
 	if ((fd = open(DFILE_NAME, O_RDONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -880,7 +829,7 @@ test13()
 	char *msg = "This is a test message.";
 	char buf[128];
 
-	tc = 13;
+	tc = test_case("splice", 13);
 	if ((fd = open("/dev/full", O_WRONLY)) < 0)
 		t_err("open", fd, errno);
 
@@ -931,7 +880,7 @@ test14()
 	ssize_t s;
 	fd_args_t a;
 
-	tc = 14;
+	tc = test_case("splice", 14);
 	if ((tfd = open(TMP_FILE, O_WRONLY | O_CREAT, 0644)) < 0)
 		t_err("open", tfd, errno);
 
@@ -940,6 +889,7 @@ test14()
 
 	a.fd0 = pfd[0];
 	a.fd1 = tfd;
+	a.tid = syscall(SYS_gettid);
 
 	pthread_create(&tid, NULL, (void *(*)(void *))fd_close, (void *)&a);
 
@@ -969,7 +919,7 @@ test15()
 	char buf[64 * 1024];
 	char *msg = "This is a test message.";
 
-	tc = 15;
+	tc = test_case("splice", 15);
 	if ((rc = pipe(pfd)) != 0)
 		t_err("pipe", rc, errno);
 
@@ -1001,6 +951,10 @@ main(int argc, char **argv)
 
 	unlink(TMP_FILE);
 
+	/* The socket tests all connect through this listener */
+	if ((server_fd = loopback_listen(&server_port)) < 0)
+		t_err("listen", server_fd, errno);
+
 	/* Create a 64k data file which will completely fit into a Linux pipe */
 	create_data_file(64 * 1024);
 
@@ -1033,5 +987,6 @@ main(int argc, char **argv)
 		test14();
 	test15();
 
+	close(server_fd);
 	return (test_pass("splice"));
 }
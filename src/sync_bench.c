@@ -0,0 +1,286 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Benchmark how long it takes to make data durable: fsync(), fdatasync(),
+ * sync_file_range(), writes to a file opened O_DSYNC, and Linux native aio
+ * IOCB_CMD_FSYNC and IOCB_CMD_FDSYNC.
+ *
+ * Each point overwrites the start of a file with one pwritev() of 'size'
+ * bytes, from 4k up to LXTST_BENCH_SYNC_MB megabytes in steps of four, and
+ * then makes it durable with the method being measured. The time recorded is
+ * that of the whole commit, from the start of the write until the method
+ * returns; 'write_p50' is the median time of the write alone, so what's left
+ * is the flush. A file opened O_DSYNC has nothing to do after the write.
+ * Since the data is overwritten in place, fdatasync() has no metadata to
+ * write which a database couldn't do without. sync_file_range() waits for
+ * the data to be written but flushes neither metadata nor the disk's cache,
+ * so it's there for comparison rather than as a way to commit.
+ *
+ * The benchmarks are named sync.<method>.<size>, e.g. sync.fdatasync.4k.
+ * Each point carries on past the end of the run time until there are
+ * SYNC_MIN_RUNS samples, since the biggest commits take seconds.
+ *
+ * Where /proc/diskstats has the device the file is on, 'amp' is the write
+ * amplification: the bytes written to the device while measuring, journal
+ * and metadata included, over the bytes the benchmark wrote. Anything else
+ * writing to the device at the same time is counted too.
+ *
+ * The file is made in LXTST_BENCH_DIR, or the current directory.
+ */
+
+#define	_GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include "lxtst.h"
+#include "lxaio.h"
+#include "lxbench.h"
+
+#define	DFLT_SYNC_MB	1024
+#define	SYNC_MIN_SIZE	4096
+#define	SYNC_CHUNK	(1024 * 1024)	/* every iovec is the one buffer */
+#define	SYNC_MAX_IOV	1024
+#define	SYNC_MIN_RUNS	5
+
+enum {
+	M_FSYNC,
+	M_FDATASYNC,
+	M_SFR,
+	M_DSYNC,
+	M_AIO_FSYNC,
+	M_AIO_FDSYNC
+};
+
+static struct method {
+	const char	*m_name;
+	int		m_method;
+} methods[] = {
+	{ "fsync",		M_FSYNC },
+	{ "fdatasync",		M_FDATASYNC },
+	{ "sync_file_range",	M_SFR },
+	{ "o_dsync",		M_DSYNC },
+	{ "aio_fsync",		M_AIO_FSYNC },
+	{ "aio_fdsync",		M_AIO_FDSYNC },
+	{ NULL, 0 }
+};
+
+static char fpath[1024];
+static char *buf;
+static struct iovec iov[SYNC_MAX_IOV];
+
+/*
+ * The sectors written so far to the device with number 'dev', from
+ * /proc/diskstats, or -1 if it isn't there.
+ */
+static long long
+dev_sectors(dev_t dev)
+{
+	FILE *fp;
+	char line[256];
+	unsigned int maj, min;
+	long long sect = -1, ws;
+
+	if ((fp = fopen("/proc/diskstats", "r")) == NULL)
+		return (-1);
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if (sscanf(line, "%u %u %*s %*u %*u %*u %*u %*u %*u %lld",
+		    &maj, &min, &ws) == 3 && maj == major(dev) &&
+		    min == minor(dev)) {
+			sect = ws;
+			break;
+		}
+	}
+	(void) fclose(fp);
+	return (sect);
+}
+
+/* Make the write durable with 'method'; returns 0, or an errno */
+static int
+commit(aio_context_t ctx, int fd, int method, size_t size)
+{
+	struct iocb cb, *cbp = &cb;
+	struct io_event ev;
+	int rc;
+
+	switch (method) {
+	case M_FSYNC:
+		return (fsync(fd) == 0 ? 0 : errno);
+	case M_FDATASYNC:
+		return (fdatasync(fd) == 0 ? 0 : errno);
+	case M_SFR:
+		rc = sync_file_range(fd, 0, size, SYNC_FILE_RANGE_WAIT_BEFORE |
+		    SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+		return (rc == 0 ? 0 : errno);
+	case M_DSYNC:
+		return (0);
+	}
+
+	/* The kernel insists that everything else in the iocb is zero */
+	(void) memset(&cb, 0, sizeof (cb));
+	cb.aio_lio_opcode = method == M_AIO_FSYNC ? IOCB_CMD_FSYNC :
+	    IOCB_CMD_FDSYNC;
+	cb.aio_fildes = fd;
+	if (io_submit(ctx, 1, &cbp) != 1)
+		return (errno);
+	while ((rc = io_getevents(ctx, 1, 1, &ev, NULL)) != 1) {
+		if (rc < 0 && errno != EINTR)
+			return (errno);
+	}
+	return (ev.res < 0 ? (int)-ev.res : 0);
+}
+
+/* Overwrite the first 'size' bytes of the file with one pwritev() */
+static int
+dirty(int fd, size_t size)
+{
+	size_t left;
+	ssize_t rc;
+	int n;
+
+	for (n = 0, left = size; left > 0; n++) {
+		iov[n].iov_base = buf;
+		iov[n].iov_len = left < SYNC_CHUNK ? left : SYNC_CHUNK;
+		left -= iov[n].iov_len;
+	}
+	if ((rc = pwritev(fd, iov, n, 0)) < 0)
+		return (errno);
+	return (rc == size ? 0 : EIO);
+}
+
+static void
+run_sync(const char *name, struct method *mp, size_t size)
+{
+	aio_context_t ctx = 0;
+	bench_hist_t *hp, *whp;
+	struct stat st;
+	uint64_t t0, t1, t2, mstart, mend, ops = 0, busy = 0;
+	long long s0, s1;
+	int fd, rc;
+
+	if ((hp = bench_hist_alloc()) == NULL ||
+	    (whp = bench_hist_alloc()) == NULL)
+		bench_fail(name, "out of memory");
+	fd = open(fpath, O_RDWR | O_CREAT | (mp->m_method == M_DSYNC ?
+	    O_DSYNC : 0), 0644);
+	if (fd < 0 || fstat(fd, &st) != 0)
+		bench_fail(name, strerror(errno));
+	if (io_setup(1, &ctx) < 0)
+		bench_fail(name, strerror(errno));
+
+	/* The first commit allocates the file's blocks, so isn't timed */
+	if ((rc = dirty(fd, size)) != 0)
+		bench_fail(name, strerror(rc));
+	if ((rc = commit(ctx, fd, mp->m_method, size)) == EINVAL &&
+	    (mp->m_method == M_AIO_FSYNC || mp->m_method == M_AIO_FDSYNC)) {
+		bench_skip(name, "aio fsync is not supported on this file");
+		goto out;
+	}
+	if (rc != 0)
+		bench_fail(name, strerror(rc));
+	if (fsync(fd) != 0)
+		bench_fail(name, strerror(errno));
+
+	s0 = dev_sectors(st.st_dev);
+	mstart = bench_now() + bench_warmup();
+	mend = mstart + bench_runtime();
+	do {
+		t0 = bench_now();
+		if ((rc = dirty(fd, size)) != 0)
+			bench_fail(name, strerror(rc));
+		t1 = bench_now();
+		if ((rc = commit(ctx, fd, mp->m_method, size)) != 0)
+			bench_fail(name, strerror(rc));
+		t2 = bench_now();
+
+		if (t0 < mstart) {
+			s0 = dev_sectors(st.st_dev);
+			continue;
+		}
+		bench_hist_record(hp, t2 - t0);
+		bench_hist_record(whp, t1 - t0);
+		busy += t2 - t0;
+		ops++;
+	} while (t2 < mend || ops < SYNC_MIN_RUNS);
+	s1 = dev_sectors(st.st_dev);
+
+	if (s0 >= 0 && s1 >= s0) {
+		bench_report(name, hp, "size_mb", size / (1024.0 * 1024),
+		    "write_p50", (double)bench_hist_pct(whp, 50.0),
+		    "mb_s", ops * size / (busy / 1e9) / (1024 * 1024),
+		    "amp", (s1 - s0) * 512.0 / (ops * size), NULL);
+	} else {
+		bench_report(name, hp, "size_mb", size / (1024.0 * 1024),
+		    "write_p50", (double)bench_hist_pct(whp, 50.0),
+		    "mb_s", ops * size / (busy / 1e9) / (1024 * 1024), NULL);
+	}
+
+out:
+	(void) io_destroy(ctx);
+	(void) close(fd);
+	bench_hist_free(whp);
+	bench_hist_free(hp);
+}
+
+/* e.g. 4k, 256k, 1m, 1g */
+static void
+size_name(char *s, size_t len, size_t size)
+{
+	if (size >= 1024 * 1024 * 1024)
+		(void) snprintf(s, len, "%zug", size / (1024 * 1024 * 1024));
+	else if (size >= 1024 * 1024)
+		(void) snprintf(s, len, "%zum", size / (1024 * 1024));
+	else
+		(void) snprintf(s, len, "%zuk", size / 1024);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct method *mp;
+	char name[80], sz[16], *dir, *s;
+	size_t size, max = (size_t)DFLT_SYNC_MB * 1024 * 1024;
+
+	bench_init();
+
+	if ((s = getenv("LXTST_BENCH_SYNC_MB")) != NULL && atoi(s) > 0)
+		max = (size_t)atoi(s) * 1024 * 1024;
+	if (max > (size_t)SYNC_MAX_IOV * SYNC_CHUNK)
+		max = (size_t)SYNC_MAX_IOV * SYNC_CHUNK;
+	if ((dir = getenv("LXTST_BENCH_DIR")) == NULL || *dir == '\0')
+		dir = ".";
+	(void) snprintf(fpath, sizeof (fpath), "%s/lxtmp-sync-bench.%d", dir,
+	    (int)getpid());
+
+	if ((buf = malloc(SYNC_CHUNK)) == NULL)
+		bench_fail("sync", "out of memory");
+	pattern_fill(buf, SYNC_CHUNK, 0);
+
+	for (mp = methods; mp->m_name != NULL; mp++) {
+		for (size = SYNC_MIN_SIZE; size <= max; size *= 4) {
+			size_name(sz, sizeof (sz), size);
+			(void) snprintf(name, sizeof (name), "sync.%s.%s",
+			    mp->m_name, sz);
+			if (bench_selected(argc, argv, name))
+				run_sync(name, mp, size);
+		}
+	}
+
+	(void) unlink(fpath);
+	free(buf);
+	return (0);
+}
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -46,7 +46,7 @@ typedef struct dexpect {
 	char	*d_name;
 } dexpect_t;
 
-dexpect_t topdir[] = {
+static dexpect_t topdir[] = {
 	{DT_DIR, "block"},
 	{DT_DIR, "bus"},
 	{DT_DIR, "class"},
@@ -55,45 +55,45 @@ dexpect_t topdir[] = {
 	{0, NULL}
 };
 
-dexpect_t blockdir[] = {
+static dexpect_t blockdir[] = {
 	{DT_LNK, "zfsds0"},
 	{0, NULL}
 };
 
-dexpect_t classdir[] = {
+static dexpect_t classdir[] = {
 	{DT_DIR, "net"},
 	{0, NULL}
 };
 
-dexpect_t netdir[] = {
+static dexpect_t netdir[] = {
 	{DT_LNK, "eth0"},
 	{DT_LNK, "lo"},
 	{0, NULL}
 };
 
-dexpect_t devicesdir[] = {
+static dexpect_t devicesdir[] = {
 	{DT_DIR, "system"},
 	{DT_DIR, "virtual"},
 	{0, NULL}
 };
 
-dexpect_t systemdir[] = {
+static dexpect_t systemdir[] = {
 	{DT_DIR, "cpu"},
 	{DT_DIR, "node"},
 	{0, NULL}
 };
 
-dexpect_t nodedir[] = {
+static dexpect_t nodedir[] = {
 	{DT_DIR, "node0"},
 	{0, NULL}
 };
 
-dexpect_t node0dir[] = {
+static dexpect_t node0dir[] = {
 	{DT_REG, "cpulist"},
 	{0, NULL}
 };
 
-dexpect_t cpudir[] = {
+static dexpect_t cpudir[] = {
 	{DT_DIR, "cpu0"},
 	{DT_REG, "kernel_max"},
 	{DT_REG, "offline"},
@@ -103,7 +103,7 @@ dexpect_t cpudir[] = {
 	{0, NULL}
 };
 
-dexpect_t netlodir[] = {
+static dexpect_t netlodir[] = {
 	{DT_REG, "address"},
 	{DT_REG, "addr_len"},
 	{DT_REG, "flags"},
@@ -117,7 +117,7 @@ dexpect_t netlodir[] = {
 static void
 tfail(char *msg)
 {
-	printf("FAIL %s %d: %s\n", TST_NAME, tc, msg);
+	(void) test_case_fail(TST_NAME, tc, msg);
 	exit(1);
 }
 
@@ -246,7 +246,7 @@ check_dir(char *path, dexpect_t *ents)
 	}
 }
 
-void
+static void
 use_twice()
 {
 	int fd1, fd2;
@@ -275,7 +275,7 @@ main(int argc, char **argv)
 		is_lx = 1;
 
 	/* check sysfs magic number */
-	tc = 1;
+	tc = test_case(TST_NAME, 1);
 	if (statfs(MNT_PNT, &sfs) != 0)  {
 		return (test_fail(TST_NAME, "1 - statfs"));
 	}
@@ -288,7 +288,7 @@ main(int argc, char **argv)
 	/*
 	 * check inode consistency across spots we know transition internally
 	 */
-	tc = 2;
+	tc = test_case(TST_NAME, 2);
 	/* gcc apprently puts string constants into a non-writable page */
 	strcpy(path, MNT_PNT "/block");
 	check_inode(path);
@@ -307,37 +307,37 @@ main(int argc, char **argv)
 		check_inode(path);
 	}
 
-	tc = 3;
+	tc = test_case(TST_NAME, 3);
 	check_dir(MNT_PNT, topdir);
 
-	tc = 4;
+	tc = test_case(TST_NAME, 4);
 	check_dir(MNT_PNT "/block", blockdir);
 
-	tc = 5;
+	tc = test_case(TST_NAME, 5);
 	check_dir(MNT_PNT "/class", classdir);
 
-	tc = 6;
+	tc = test_case(TST_NAME, 6);
 	check_dir(MNT_PNT "/class/net", netdir);
 
-	tc = 7;
+	tc = test_case(TST_NAME, 7);
 	check_dir(MNT_PNT "/devices", devicesdir);
 
-	tc = 8;
+	tc = test_case(TST_NAME, 8);
 	check_dir(MNT_PNT "/devices/system", systemdir);
 
-	tc = 9;
+	tc = test_case(TST_NAME, 9);
 	check_dir(MNT_PNT "/devices/system/cpu", cpudir);
 
-	tc = 10;
+	tc = test_case(TST_NAME, 10);
 	check_dir(MNT_PNT "/devices/system/node", nodedir);
 
-	tc = 11;
+	tc = test_case(TST_NAME, 11);
 	check_dir(MNT_PNT "/devices/system/node/node0", node0dir);
 
-	tc = 12;
+	tc = test_case(TST_NAME, 12);
 	check_dir(MNT_PNT "/devices/virtual/net/lo", netlodir);
 
-	tc = 13;
+	tc = test_case(TST_NAME, 13);
 	use_twice();
 
 	return (test_pass(TST_NAME));
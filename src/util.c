@@ -5,30 +5,409 @@
  */
 
 /*
- * Copyright (c) 2016, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Test result reporting.
+ *
+ * By default results are printed as "PASS name", "FAIL name: why" and
+ * "SKIP name: why" lines. If LXTST_OUTPUT is set to "json" each result is
+ * instead printed as a single JSON object per line, which includes when the
+ * test (or numbered test case) started and ended, along with the resource
+ * usage of the process and its waited-for children over that interval.
+ *
+ * A test marks the start of each of its numbered cases with test_case(). The
+ * previous case, if any, is then considered to have passed; a case which fails
+ * is reported with test_case_fail().
+ *
+ * If LXTST_CASES is set to a list of case numbers and ranges, e.g. "1,4-6",
+ * tests which support it only run those cases; see test_selected().
+ *
+ * If LXTST_LEAKS is set to 1, the kernel resources held by the process are
+ * also snapshotted at the start of the test and of each case: open fds,
+ * threads, resident memory, the system-wide count of aio contexts
+ * (/proc/sys/fs/aio-nr) and the number of mounts. When a case or the test
+ * passes, any growth since its start is reported on a "LEAK" line. Since
+ * aio-nr is system-wide, other tests running at the same time can show up in
+ * it, and resident memory is only reported once it has grown by more than
+ * LEAK_RSS_KB, since the C library holds on to memory which has been freed.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include "lxtst.h"
 
+#define	LEAK_RSS_KB	1024
+
+typedef struct res {
+	long	r_fds;		/* open file descriptors */
+	long	r_threads;
+	long	r_rss_kb;	/* VmRSS */
+	long	r_hwm_kb;	/* VmHWM */
+	long	r_aio_nr;	/* aio contexts, system-wide */
+	long	r_mounts;
+} res_t;
+
+typedef struct snap {
+	struct timespec	s_ts;
+	struct rusage	s_ru;
+	res_t		s_res;	/* only if leak_check */
+} snap_t;
+
+static int json_output;
+static int leak_check;
+static snap_t start_snap;	/* start of the test */
+static snap_t case_snap;	/* start of the current case */
+static const char *case_name;
+static int case_num;
+
+/* Count the entries in a directory, other than "." and ".." */
+static long
+count_dir(const char *path)
+{
+	DIR *dp;
+	struct dirent *de;
+	long n = 0;
+
+	if ((dp = opendir(path)) == NULL)
+		return (-1);
+	while ((de = readdir(dp)) != NULL) {
+		if (strcmp(de->d_name, ".") != 0 &&
+		    strcmp(de->d_name, "..") != 0)
+			n++;
+	}
+	(void) closedir(dp);
+	return (n);
+}
+
+static long
+count_lines(const char *path)
+{
+	FILE *fp;
+	char buf[1024];
+	long n = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return (-1);
+	while (fgets(buf, sizeof (buf), fp) != NULL) {
+		if (strchr(buf, '\n') != NULL)
+			n++;
+	}
+	(void) fclose(fp);
+	return (n);
+}
+
+static void
+take_res(res_t *rp)
+{
+	FILE *fp;
+	char buf[256];
+
+	rp->r_threads = rp->r_rss_kb = rp->r_hwm_kb = rp->r_aio_nr = -1;
+
+	/* The directory being read is itself open, so don't count it */
+	if ((rp->r_fds = count_dir("/proc/self/fd")) > 0)
+		rp->r_fds--;
+	rp->r_mounts = count_lines("/proc/self/mounts");
+
+	if ((fp = fopen("/proc/self/status", "r")) != NULL) {
+		while (fgets(buf, sizeof (buf), fp) != NULL) {
+			(void) sscanf(buf, "Threads: %ld", &rp->r_threads);
+			(void) sscanf(buf, "VmRSS: %ld", &rp->r_rss_kb);
+			(void) sscanf(buf, "VmHWM: %ld", &rp->r_hwm_kb);
+		}
+		(void) fclose(fp);
+	}
+
+	if ((fp = fopen("/proc/sys/fs/aio-nr", "r")) != NULL) {
+		if (fscanf(fp, "%ld", &rp->r_aio_nr) != 1)
+			rp->r_aio_nr = -1;
+		(void) fclose(fp);
+	}
+}
+
+static void
+take_snap(snap_t *sp)
+{
+	struct rusage c;
+
+	clock_gettime(CLOCK_MONOTONIC, &sp->s_ts);
+	getrusage(RUSAGE_SELF, &sp->s_ru);
+	getrusage(RUSAGE_CHILDREN, &c);
+
+	timeradd(&sp->s_ru.ru_utime, &c.ru_utime, &sp->s_ru.ru_utime);
+	timeradd(&sp->s_ru.ru_stime, &c.ru_stime, &sp->s_ru.ru_stime);
+	sp->s_ru.ru_minflt += c.ru_minflt;
+	sp->s_ru.ru_majflt += c.ru_majflt;
+	sp->s_ru.ru_nvcsw += c.ru_nvcsw;
+	sp->s_ru.ru_nivcsw += c.ru_nivcsw;
+
+	if (leak_check)
+		take_res(&sp->s_res);
+}
+
+static void __attribute__((constructor))
+util_init()
+{
+	char *s;
+
+	if ((s = getenv("LXTST_OUTPUT")) != NULL && strcmp(s, "json") == 0)
+		json_output = 1;
+	if ((s = getenv("LXTST_LEAKS")) != NULL && strcmp(s, "1") == 0)
+		leak_check = 1;
+	take_snap(&start_snap);
+}
+
+static uint64_t
+ts_nsec(struct timespec *tp)
+{
+	return ((uint64_t)tp->tv_sec * 1000000000ULL + tp->tv_nsec);
+}
+
+static uint64_t
+tv_usec(struct timeval *tp)
+{
+	return ((uint64_t)tp->tv_sec * 1000000ULL + tp->tv_usec);
+}
+
+static void
+json_str(const char *s)
+{
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			printf("\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			printf("\\u%04x", *s);
+		} else {
+			putchar(*s);
+		}
+	}
+	putchar('"');
+}
+
+/*
+ * Print one result. A case of -1 is the result of the test as a whole. The
+ * interval reported is from the given snapshot until now.
+ */
+static void
+report(const char *res, const char *name, int tc, const char *msg,
+    snap_t *from)
+{
+	snap_t now;
+	struct timeval ut, st;
+
+	if (!json_output) {
+		printf("%s %s", res, name);
+		if (tc >= 0)
+			printf(" %d", tc);
+		if (msg != NULL)
+			printf(": %s", msg);
+		putchar('\n');
+		fflush(stdout);
+		return;
+	}
+
+	take_snap(&now);
+	timersub(&now.s_ru.ru_utime, &from->s_ru.ru_utime, &ut);
+	timersub(&now.s_ru.ru_stime, &from->s_ru.ru_stime, &st);
+
+	printf("{\"result\":\"%s\",\"name\":", res);
+	json_str(name);
+	if (tc >= 0)
+		printf(",\"case\":%d", tc);
+	if (msg != NULL) {
+		printf(",\"msg\":");
+		json_str(msg);
+	}
+	printf(",\"start_ns\":%llu,\"end_ns\":%llu"
+	    ",\"utime_us\":%llu,\"stime_us\":%llu"
+	    ",\"nvcsw\":%ld,\"nivcsw\":%ld,\"minflt\":%ld,\"majflt\":%ld}\n",
+	    (unsigned long long)ts_nsec(&from->s_ts),
+	    (unsigned long long)ts_nsec(&now.s_ts),
+	    (unsigned long long)tv_usec(&ut), (unsigned long long)tv_usec(&st),
+	    now.s_ru.ru_nvcsw - from->s_ru.ru_nvcsw,
+	    now.s_ru.ru_nivcsw - from->s_ru.ru_nivcsw,
+	    now.s_ru.ru_minflt - from->s_ru.ru_minflt,
+	    now.s_ru.ru_majflt - from->s_ru.ru_majflt);
+
+	/* Don't leave anything buffered for a forked child to repeat. */
+	fflush(stdout);
+}
+
+/* Add one item to a LEAK line, if it has grown. */
+static int
+leak_item(int n, const char *what, long from, long to, long min)
+{
+	if (from < 0 || to < 0 || to - from <= min)
+		return (n);
+
+	if (json_output) {
+		printf(",\"%s\":%ld", what, to - from);
+	} else {
+		printf("%s %s +%ld (%ld -> %ld)", n == 0 ? ":" : ",", what,
+		    to - from, from, to);
+	}
+	return (n + 1);
+}
+
+/*
+ * Report any growth in the resources held since the given snapshot. A case of
+ * -1 is the test as a whole.
+ */
+static void
+leak_report(const char *name, int tc, snap_t *from)
+{
+	res_t now, *fp = &from->s_res;
+	int n = 0;
+
+	take_res(&now);
+	if (now.r_fds <= fp->r_fds && now.r_threads <= fp->r_threads &&
+	    now.r_aio_nr <= fp->r_aio_nr && now.r_mounts <= fp->r_mounts &&
+	    now.r_rss_kb - fp->r_rss_kb <= LEAK_RSS_KB)
+		return;
+
+	if (json_output) {
+		printf("{\"result\":\"LEAK\",\"name\":");
+		json_str(name);
+		if (tc >= 0)
+			printf(",\"case\":%d", tc);
+	} else {
+		printf("LEAK %s", name);
+		if (tc >= 0)
+			printf(" %d", tc);
+	}
+
+	n = leak_item(n, "fds", fp->r_fds, now.r_fds, 0);
+	n = leak_item(n, "threads", fp->r_threads, now.r_threads, 0);
+	n = leak_item(n, "aio_nr", fp->r_aio_nr, now.r_aio_nr, 0);
+	n = leak_item(n, "mounts", fp->r_mounts, now.r_mounts, 0);
+	n = leak_item(n, "rss_kb", fp->r_rss_kb, now.r_rss_kb, LEAK_RSS_KB);
+	if (n > 0 && now.r_rss_kb - fp->r_rss_kb > LEAK_RSS_KB) {
+		if (json_output)
+			printf(",\"hwm_kb\":%ld", now.r_hwm_kb);
+		else
+			printf(" (hwm %ld)", now.r_hwm_kb);
+	}
+
+	printf(json_output ? "}\n" : "\n");
+	fflush(stdout);
+}
+
+/* The current case has run to completion. */
+static void
+case_done()
+{
+	if (case_name == NULL)
+		return;
+
+	/* Passing cases are only worth a line when they carry timing. */
+	if (json_output)
+		report("PASS", case_name, case_num, NULL, &case_snap);
+	if (leak_check)
+		leak_report(case_name, case_num, &case_snap);
+	case_name = NULL;
+}
+
+int
+test_case(const char *name, int tc)
+{
+	/* Already started, e.g. by the parent of a forked case */
+	if (case_name != NULL && case_num == tc && strcmp(case_name, name) == 0)
+		return (tc);
+
+	case_done();
+	case_name = name;
+	case_num = tc;
+	take_snap(&case_snap);
+	return (tc);
+}
+
+int
+test_case_fail(const char *name, int tc, const char *msg)
+{
+	if (case_name != NULL && case_num == tc &&
+	    strcmp(case_name, name) == 0) {
+		report("FAIL", name, tc, msg, &case_snap);
+		case_name = NULL;
+	} else {
+		report("FAIL", name, tc, msg, &start_snap);
+	}
+	return (1);
+}
+
+/*
+ * Returns non-zero if numbered case 'tc' should be run. The list is re-read on
+ * each call, since the multi-call binary may change it between tests.
+ */
+int
+test_selected(int tc)
+{
+	char *s, *e;
+	long lo, hi;
+
+	if ((s = getenv("LXTST_CASES")) == NULL || *s == '\0')
+		return (1);
+
+	while (*s != '\0') {
+		lo = hi = strtol(s, &e, 10);
+		if (e == s)
+			return (0);
+		if (*e == '-') {
+			s = e + 1;
+			hi = strtol(s, &e, 10);
+			if (e == s)
+				return (0);
+		}
+		if (tc >= lo && tc <= hi)
+			return (1);
+		if (*e != ',')
+			return (0);
+		s = e + 1;
+	}
+	return (0);
+}
+
+/*
+ * Start reporting afresh, for running a test more than once in a process; see
+ * lxtst.c.
+ */
+void
+test_reset()
+{
+	case_name = NULL;
+	take_snap(&start_snap);
+}
+
 int
 test_pass(const char *name)
 {
-	printf("PASS %s\n", name);
+	case_done();
+	report("PASS", name, -1, NULL, &start_snap);
+	if (leak_check)
+		leak_report(name, -1, &start_snap);
 	return (0);
 }
 
 int
 test_fail(const char *name, const char *msg)
 {
-	printf("FAIL %s: %s\n", name, msg);
+	case_name = NULL;
+	report("FAIL", name, -1, msg, &start_snap);
 	return (1);
 }
 
 int
 test_skip(const char *name, const char *why)
 {
-	printf("SKIP %s: %s\n", name, why);
+	case_done();
+	report("SKIP", name, -1, why, &start_snap);
 	return (0);
 }
-
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (c) 2017, Joyent, Inc.
+ * Copyright (c) 2026, Joyent, Inc.
  */
 
 #include <unistd.h>
@@ -32,7 +32,7 @@ static int tc;
 static void
 tfail(char *msg)
 {
-	printf("FAIL %s %d: %s\n", TST_NAME, tc, msg);
+	(void) test_case_fail(TST_NAME, tc, msg);
 	exit(1);
 }
 
@@ -62,7 +62,7 @@ main(int argc, char *argv[])
 	int fd;
 	struct stat sb;
 
-	tc = 1;
+	tc = test_case(TST_NAME, 1);
 	if ((fd = open("/dev/zfsds0", O_RDONLY)) < 0)
 		tfail("/dev/zfs - open failed");
 
@@ -81,7 +81,7 @@ main(int argc, char *argv[])
 		return (test_pass(TST_NAME));
 	}
 
-	tc = 2;
+	tc = test_case(TST_NAME, 2);
 	if ((sb.st_mode & S_IFMT) != S_IFBLK)
 		tfail("not a block device");
 
@@ -0,0 +1,265 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Copyright (c) 2026, Joyent, Inc.
+ */
+
+/*
+ * Checking test data in-process.
+ *
+ * verify_files() compares two files by mapping them a window at a time and
+ * using memcmp(), which the C library vectorizes, so that even very large
+ * files can be checked without running diff(1).
+ *
+ * Data which a test generates itself can instead be checked against a
+ * CRC32C. pattern_fill() writes a pattern in which every 8-byte word depends
+ * on its position, so data which is moved or duplicated is caught as well as
+ * data which is corrupted, and pattern_check() compares the CRC32C of a
+ * buffer with that of the pattern, without making a second copy of it.
+ * crc32c() uses the SSE4.2 crc32 instruction when the CPU has it, and
+ * slice-by-8 tables otherwise.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "lxtst.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#define	CRC32C_POLY	0x82f63b78	/* Castagnoli, reflected */
+
+/* How much of each file verify_files() maps at a time */
+#define	VERIFY_WINDOW	(64 * 1024 * 1024)
+
+static uint32_t crc_tab[8][256];
+static int crc_hw;
+
+/*
+ * Done when the program is loaded, before any thread can be checking data,
+ * so that crc32c() never sees the tables half written.
+ */
+static void __attribute__((constructor))
+crc_init()
+{
+	uint32_t c;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = (c >> 1) ^ ((c & 1) ? CRC32C_POLY : 0);
+		crc_tab[0][i] = c;
+	}
+	for (i = 0; i < 256; i++) {
+		c = crc_tab[0][i];
+		for (j = 1; j < 8; j++) {
+			c = crc_tab[0][c & 0xff] ^ (c >> 8);
+			crc_tab[j][i] = c;
+		}
+	}
+
+#if defined(__x86_64__)
+	crc_hw = __builtin_cpu_supports("sse4.2");
+#else
+	crc_hw = 0;
+#endif
+}
+
+static uint32_t
+crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t w;
+
+	while (len > 0 && ((uintptr_t)p & 7) != 0) {
+		crc = crc_tab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	while (len >= 8) {
+		/* the tables assume the word is little-endian */
+		memcpy(&w, p, sizeof (w));
+		w ^= crc;
+		crc = crc_tab[7][w & 0xff] ^
+		    crc_tab[6][(w >> 8) & 0xff] ^
+		    crc_tab[5][(w >> 16) & 0xff] ^
+		    crc_tab[4][(w >> 24) & 0xff] ^
+		    crc_tab[3][(w >> 32) & 0xff] ^
+		    crc_tab[2][(w >> 40) & 0xff] ^
+		    crc_tab[1][(w >> 48) & 0xff] ^
+		    crc_tab[0][w >> 56];
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0)
+		crc = crc_tab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return (crc);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t c = crc, w;
+
+	while (len > 0 && ((uintptr_t)p & 7) != 0) {
+		c = _mm_crc32_u8(c, *p++);
+		len--;
+	}
+	while (len >= 8) {
+		memcpy(&w, p, sizeof (w));
+		c = _mm_crc32_u64(c, w);
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0)
+		c = _mm_crc32_u8(c, *p++);
+	return ((uint32_t)c);
+}
+#endif
+
+/*
+ * The CRC32C of 'len' bytes at 'buf', continuing from 'crc', which is 0 to
+ * start, so that crc32c(crc32c(0, a, alen), b, blen) is the CRC32C of a and
+ * b together.
+ */
+uint32_t
+crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	crc = ~crc;
+#if defined(__x86_64__)
+	if (crc_hw)
+		return (~crc32c_hw(crc, buf, len));
+#endif
+	return (~crc32c_sw(crc, buf, len));
+}
+
+/* The pattern word at word offset 'i' (splitmix64) */
+static uint64_t
+pattern_word(uint64_t seed, uint64_t i)
+{
+	uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15ULL;
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return (z ^ (z >> 31));
+}
+
+/* Fill 'len' bytes at 'buf' with the pattern for 'seed' */
+void
+pattern_fill(void *buf, size_t len, uint64_t seed)
+{
+	unsigned char *p = buf;
+	uint64_t i, w;
+
+	for (i = 0; len >= 8; i++, p += 8, len -= 8) {
+		w = pattern_word(seed, i);
+		memcpy(p, &w, 8);
+	}
+	if (len > 0) {
+		w = pattern_word(seed, i);
+		memcpy(p, &w, len);
+	}
+}
+
+/* The CRC32C of the first 'len' bytes of the pattern for 'seed' */
+uint32_t
+pattern_crc(size_t len, uint64_t seed)
+{
+	uint64_t chunk[512];
+	uint32_t crc = 0;
+	uint64_t i = 0;
+	size_t n;
+	int j;
+
+	while (len > 0) {
+		n = len < sizeof (chunk) ? len : sizeof (chunk);
+		for (j = 0; j < (n + 7) / 8; j++)
+			chunk[j] = pattern_word(seed, i++);
+		crc = crc32c(crc, chunk, n);
+		len -= n;
+	}
+	return (crc);
+}
+
+/* Returns 0 if the 'len' bytes at 'buf' hold the pattern for 'seed' */
+int
+pattern_check(const void *buf, size_t len, uint64_t seed)
+{
+	return (crc32c(0, buf, len) == pattern_crc(len, seed) ? 0 : -1);
+}
+
+/*
+ * Returns 0 if the two files have the same contents, 1 if they don't, or -1
+ * with errno set if they can't be read.
+ */
+int
+verify_files(const char *path1, const char *path2)
+{
+	int fd1, fd2, res = 0, err;
+	struct stat sb1, sb2;
+	off_t off;
+	size_t len;
+	void *m1, *m2;
+
+	if ((fd1 = open(path1, O_RDONLY)) < 0)
+		return (-1);
+	if ((fd2 = open(path2, O_RDONLY)) < 0) {
+		err = errno;
+		(void) close(fd1);
+		errno = err;
+		return (-1);
+	}
+
+	if (fstat(fd1, &sb1) < 0 || fstat(fd2, &sb2) < 0) {
+		res = -1;
+		goto done;
+	}
+	if (sb1.st_size != sb2.st_size) {
+		res = 1;
+		goto done;
+	}
+
+	for (off = 0; off < sb1.st_size && res == 0; off += len) {
+		len = sb1.st_size - off < VERIFY_WINDOW ?
+		    sb1.st_size - off : VERIFY_WINDOW;
+
+		m1 = mmap(NULL, len, PROT_READ, MAP_SHARED, fd1, off);
+		if (m1 == MAP_FAILED) {
+			res = -1;
+			break;
+		}
+		m2 = mmap(NULL, len, PROT_READ, MAP_SHARED, fd2, off);
+		if (m2 == MAP_FAILED) {
+			(void) munmap(m1, len);
+			res = -1;
+			break;
+		}
+		(void) madvise(m1, len, MADV_SEQUENTIAL);
+		(void) madvise(m2, len, MADV_SEQUENTIAL);
+
+		if (memcmp(m1, m2, len) != 0)
+			res = 1;
+
+		(void) munmap(m1, len);
+		(void) munmap(m2, len);
+	}
+
+done:
+	err = errno;
+	(void) close(fd1);
+	(void) close(fd2);
+	errno = err;
+	return (res);
+}